@@ -0,0 +1,247 @@
+#include "common/threadblock.hpp"
+#include "common/traffic.hpp"
+#include "common/xml_generator.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+/**
+ * Microbenchmarks of the hot paths of verifier_core.
+ *
+ * Inputs are generated in memory, so the numbers only depend on the parameters in their names:
+ * ranks, threadblocks (one channel each) and chunks.
+ */
+
+static std::string Step(int s, const char* type, const char* src_buff, int src_off, const char* dst_buff, int dst_off,
+                        int dep_tbid = -1, int dep_step = -1, bool has_dep = false) {
+    std::ostringstream os;
+    os << "      <step s=\"" << s << "\" type=\"" << type << "\" srcbuf=\"" << src_buff << "\" srcoff=\"" << src_off
+       << "\" dstbuf=\"" << dst_buff << "\" dstoff=\"" << dst_off << "\" cnt=\"1\" depid=\"" << dep_tbid << "\" deps=\"" << dep_step
+       << "\" hasdep=\"" << (has_dep ? 1 : 0) << "\"/>\n";
+    return os.str();
+}
+
+/**
+ * @brief A ring allgather of num_chunks chunks per rank, split over num_tbs channels.
+ */
+static std::string RingAllgatherXml(int num_ranks, int num_tbs, int num_chunks) {
+    GeneratorOptions options;
+    options.num_ranks = num_ranks;
+    options.num_channels = num_tbs;
+    options.chunk_factor = num_chunks;
+    return GenerateXml(options);
+}
+
+/**
+ * @brief A single rank whose threadblocks run nops, each depending on the same step of the previous threadblock.
+ */
+static std::string DependencyChainXml(int num_tbs, int num_steps) {
+    std::ostringstream os;
+    os << "<algo name=\"chain\" proto=\"Simple\" nchannels=\"1\" nchunksperloop=\"1\" ngpus=\"1\" coll=\"allgather\" inplace=\"0\" outofplace=\"1\">\n";
+    os << "  <gpu id=\"0\" i_chunks=\"1\" o_chunks=\"1\" s_chunks=\"0\">\n";
+    for (int t = 0; t < num_tbs; ++t) {
+        os << "    <tb id=\"" << t << "\" send=\"-1\" recv=\"-1\" chan=\"0\">\n";
+        for (int s = 0; s < num_steps; ++s) {
+            os << Step(s, "nop", "i", 0, "o", 0, t > 0 ? t - 1 : -1, t > 0 ? s : -1, t + 1 < num_tbs);
+        }
+        os << "    </tb>\n";
+    }
+    os << "  </gpu>\n</algo>\n";
+    return os.str();
+}
+
+/**
+ * @brief A parsed XML document and the CommGroup built from it.
+ */
+struct Fixture {
+    tinyxml2::XMLDocument doc;
+    std::shared_ptr<CommGroup> comm_group;
+
+    explicit Fixture(const std::string& xml) {
+        doc.Parse(xml.c_str());
+        if (doc.Error()) {
+            throw std::runtime_error(std::string("Invalid generated XML: ") + doc.ErrorStr());
+        }
+        comm_group = std::make_shared<CommGroup>();
+        comm_group->InitializeRanks(doc.RootElement());
+    }
+};
+
+static ChunkDataType AllgatherInput(int rank_id, size_t index) {
+    return ChunkDataType(rank_id, index);
+}
+
+static void BM_MailboxRoundTrip(benchmark::State& state) {
+    Mailbox mailbox;
+    Message msg;
+    msg.chunks.assign(state.range(0), ChunkDataType(0, 0));
+    Message received;
+    for (auto _ : state) {
+        mailbox.sendMessage(msg);
+        mailbox.receiveMessage(received);
+        benchmark::DoNotOptimize(received.chunks.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MailboxRoundTrip)->ArgName("chunks")->RangeMultiplier(8)->Range(1, 512);
+
+static void BM_DependencyWait(benchmark::State& state) {
+    const int num_tbs = static_cast<int>(state.range(0));
+    const int num_steps = static_cast<int>(state.range(1));
+    Fixture fixture(DependencyChainXml(num_tbs, num_steps));
+    auto rank = fixture.comm_group->getRank(0);
+    for (auto _ : state) {
+        rank->ResetInstructionSteps();
+        // Step by step across threadblocks, so every dependency is met when it is checked
+        for (int s = 0; s < num_steps; ++s) {
+            for (int t = 0; t < num_tbs; ++t) {
+                rank->getThreadBlock(t)->ExecuteSingleStep(s);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * num_tbs * num_steps);
+}
+BENCHMARK(BM_DependencyWait)->ArgNames({"tbs", "steps"})->ArgsProduct({{2, 16, 64}, {16, 48}});
+
+static void BM_ParseInstructions(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    const int num_tbs = static_cast<int>(state.range(1));
+    const int num_chunks = static_cast<int>(state.range(2));
+    tinyxml2::XMLDocument doc;
+    doc.Parse(RingAllgatherXml(num_ranks, num_tbs, num_chunks).c_str());
+    std::vector<tinyxml2::XMLElement*> steps;
+    for (auto gpu = doc.RootElement()->FirstChildElement("gpu"); gpu; gpu = gpu->NextSiblingElement("gpu")) {
+        for (auto tb = gpu->FirstChildElement("tb"); tb; tb = tb->NextSiblingElement("tb")) {
+            for (auto step = tb->FirstChildElement("step"); step; step = step->NextSiblingElement("step")) {
+                steps.push_back(step);
+            }
+        }
+    }
+    for (auto _ : state) {
+        for (auto step : steps) {
+            Instruction inst(step);
+            benchmark::DoNotOptimize(inst);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * steps.size());
+}
+BENCHMARK(BM_ParseInstructions)->ArgNames({"ranks", "tbs", "chunks"})->ArgsProduct({{8, 64}, {8}, {8, 16}});
+
+static void BM_InitData(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    const int num_chunks = static_cast<int>(state.range(2));
+    Fixture fixture(RingAllgatherXml(num_ranks, static_cast<int>(state.range(1)), num_chunks));
+    for (auto _ : state) {
+        fixture.comm_group->InitData(AllgatherInput, num_chunks);
+    }
+    state.SetItemsProcessed(state.iterations() * num_ranks * num_ranks * num_chunks);
+}
+BENCHMARK(BM_InitData)->ArgNames({"ranks", "tbs", "chunks"})->ArgsProduct({{8, 64}, {8}, {64, 512}});
+
+static void BM_CheckData(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    const int num_chunks = static_cast<int>(state.range(2));
+    Fixture fixture(RingAllgatherXml(num_ranks, static_cast<int>(state.range(1)), num_chunks));
+    fixture.comm_group->InitData(AllgatherInput, num_chunks);
+    fixture.comm_group->ExecuteRanks();
+    auto check_func = [num_chunks](int, size_t index) -> ChunkDataType {
+        return ChunkDataType(index / num_chunks, index % num_chunks);
+    };
+    for (auto _ : state) {
+        fixture.comm_group->CheckData(check_func, num_ranks * num_chunks);
+    }
+    state.SetItemsProcessed(state.iterations() * num_ranks * num_ranks * num_chunks);
+}
+BENCHMARK(BM_CheckData)->ArgNames({"ranks", "tbs", "chunks"})->ArgsProduct({{8, 64}, {8}, {64, 512}});
+
+static void BM_ExecuteRanks(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    const int num_chunks = static_cast<int>(state.range(2));
+    Fixture fixture(RingAllgatherXml(num_ranks, static_cast<int>(state.range(1)), num_chunks));
+    fixture.comm_group->Seed(0);
+    for (auto _ : state) {
+        fixture.comm_group->InitData(AllgatherInput, num_chunks);
+        fixture.comm_group->ExecuteRanks();
+    }
+    state.SetItemsProcessed(state.iterations() * fixture.comm_group->getNumSteps());
+}
+// Every threadblock sleeps up to 100 us before its first step, which bounds the iteration time from below
+BENCHMARK(BM_ExecuteRanks)->ArgNames({"ranks", "tbs", "chunks"})->ArgsProduct({{8, 32}, {1, 4}, {4}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * @brief A num_ranks x num_ranks traffic matrix of random entries below 1000, in a temporary CSV or binary file.
+ */
+struct TrafficFile {
+    std::string path;
+
+    TrafficFile(int num_ranks, bool binary) {
+        path = (std::filesystem::temp_directory_path() / ("verifier_bench_traffic_" + std::to_string(num_ranks) + (binary ? ".bin" : ".csv"))).string();
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<size_t> entry(0, 999);
+        std::vector<size_t> traffic(static_cast<size_t>(num_ranks) * num_ranks);
+        for (auto& t : traffic) {
+            t = entry(rng);
+        }
+        WriteTrafficMatrix(path, traffic, num_ranks, binary);
+    }
+    ~TrafficFile() {
+        std::remove(path.c_str());
+    }
+};
+
+/**
+ * @brief The line-by-line parser that ReadTrafficMatrix replaced, kept as the baseline.
+ */
+static std::vector<size_t> ReadTrafficMatrixGetline(const std::string& file, int num_ranks) {
+    std::ifstream in(file);
+    std::vector<size_t> traffic;
+    for (int i = 0; i < num_ranks; ++i) {
+        std::string line;
+        std::getline(in, line);
+        std::istringstream ss(line);
+        std::vector<std::string> cells;
+        std::string cell;
+        while (std::getline(ss, cell, ',')) {
+            cells.push_back(cell);
+        }
+        for (const auto& c : cells) {
+            traffic.push_back(std::stoul(c));
+        }
+    }
+    return traffic;
+}
+
+static void BM_ReadTrafficMatrix(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    TrafficFile file(num_ranks, false);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ReadTrafficMatrix(file.path, num_ranks));
+    }
+    state.SetItemsProcessed(state.iterations() * num_ranks * num_ranks);
+}
+BENCHMARK(BM_ReadTrafficMatrix)->ArgName("ranks")->RangeMultiplier(4)->Range(256, 4096)->Unit(benchmark::kMillisecond);
+
+static void BM_ReadTrafficMatrixBinary(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    TrafficFile file(num_ranks, true);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ReadTrafficMatrix(file.path, num_ranks));
+    }
+    state.SetItemsProcessed(state.iterations() * num_ranks * num_ranks);
+}
+BENCHMARK(BM_ReadTrafficMatrixBinary)->ArgName("ranks")->RangeMultiplier(4)->Range(256, 4096)->Unit(benchmark::kMillisecond);
+
+static void BM_ReadTrafficMatrixGetline(benchmark::State& state) {
+    const int num_ranks = static_cast<int>(state.range(0));
+    TrafficFile file(num_ranks, false);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ReadTrafficMatrixGetline(file.path, num_ranks));
+    }
+    state.SetItemsProcessed(state.iterations() * num_ranks * num_ranks);
+}
+BENCHMARK(BM_ReadTrafficMatrixGetline)->ArgName("ranks")->RangeMultiplier(4)->Range(256, 4096)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
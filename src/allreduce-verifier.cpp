@@ -0,0 +1,5 @@
+#include "common/collectives.hpp"
+
+int main(int argc, char* argv[]) {
+    return VerifierMain(argc, argv, CollectiveKind::allreduce);
+}
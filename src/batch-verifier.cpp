@@ -0,0 +1,363 @@
+#include "common/collectives.hpp"
+#include "common/traffic.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+
+/**
+ * @brief One XML to verify, from the directory or a line of the manifest.
+ */
+struct BatchEntry {
+    std::string xml_file;
+    std::optional<CollectiveKind> kind; // Taken from the coll attribute if not given
+    std::string traffic_file; // Of alltoallv
+};
+
+struct BatchResult {
+    enum class Status {
+        pass,
+        fail,  // The XML is well-formed, but an iteration failed
+        error  // The XML could not be loaded or connected
+    };
+    Status status = Status::error;
+    std::string collective;
+    int num_ranks = 0;
+    size_t num_tbs = 0;
+    int iters = 0; // Iterations completed
+    double wall_ms = 0; // Loading and verifying, without queue_ms
+    double queue_ms = 0; // Waiting for the threadblock budget
+    std::string message;
+};
+
+struct BatchOptions {
+    std::string input; // Directory of XMLs or manifest file
+    int iters = 10;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    size_t max_threadblocks = 8192;
+    std::optional<CollectiveKind> collective; // Of XMLs whose coll attribute is ambiguous
+    bool has_seed = false;
+    unsigned int seed = 0;
+    std::string output_file;
+};
+
+/**
+ * @brief Bounds the threadblocks of all XMLs in flight, and so the threads and buffers they hold.
+ *
+ * Every ExecuteRanks still starts one thread per threadblock instead of running them on a shared
+ * pool: threadblocks block on each other's messages and dependencies, so a pool with fewer
+ * workers than the threadblocks of an XML could deadlock. The budget bounds the threads instead.
+ */
+class ThreadBlockBudget {
+public:
+    explicit ThreadBlockBudget(size_t capacity): capacity(capacity), available(capacity) {}
+    /**
+     * @brief Waits until n threadblocks are available. An XML larger than the budget runs alone.
+     */
+    size_t Acquire(size_t n) {
+        n = std::min(n, capacity);
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [this, n]() { return available >= n; });
+        available -= n;
+        return n;
+    }
+    void Release(size_t n) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available += n;
+        }
+        released.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    size_t available;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+static bool MatchOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+static void PrintUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <xml_dir|manifest> [options]" << std::endl
+              << "  A manifest lists one XML per line as <xml_file> [<collective> [<traffic_file>]], relative to the manifest." << std::endl
+              << "  In a directory, every *.xml is verified; alltoallv takes its traffic from the .csv (or binary .bin) of the same name." << std::endl
+              << "  --iters=<n>                Iterations per XML (default 10)" << std::endl
+              << "  --jobs=<n>                 XMLs verified concurrently (default: the number of cores)" << std::endl
+              << "  --max-threadblocks=<n>     Threadblocks of all XMLs in flight, which bounds threads and memory (default 8192)" << std::endl
+              << "  --collective=<name>        Collective of XMLs with coll=\"allreduce\" not named by the manifest:" << std::endl
+              << "                             allreduce, alltoall or alltoallv (default: alltoallv if a .csv or .bin exists, else allreduce)" << std::endl
+              << "  --seed=<n>                 Seed of every XML (default: random, printed at start)" << std::endl
+              << "  --output=<file>            Write the results as JSON" << std::endl;
+}
+
+static BatchOptions ParseBatchOptions(int argc, char* argv[]) {
+    BatchOptions options;
+    options.input = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string value;
+        if (MatchOption(argv[i], "--iters", value)) {
+            options.iters = std::stoi(value);
+        } else if (MatchOption(argv[i], "--jobs", value)) {
+            options.jobs = std::stoi(value);
+        } else if (MatchOption(argv[i], "--max-threadblocks", value)) {
+            options.max_threadblocks = std::stoul(value);
+        } else if (MatchOption(argv[i], "--collective", value)) {
+            options.collective = ParseCollectiveKind(value);
+        } else if (MatchOption(argv[i], "--seed", value)) {
+            options.has_seed = true;
+            options.seed = std::stoul(value);
+        } else if (MatchOption(argv[i], "--output", value)) {
+            options.output_file = value;
+        } else {
+            throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+        }
+    }
+    if (options.iters < 1 || options.jobs < 1 || options.max_threadblocks < 1) {
+        throw std::runtime_error("--iters, --jobs and --max-threadblocks must be positive");
+    }
+    return options;
+}
+
+static std::vector<BatchEntry> ListEntries(const std::string& input) {
+    namespace fs = std::filesystem;
+    std::vector<BatchEntry> entries;
+    if (fs::is_directory(input)) {
+        for (const auto& file : fs::directory_iterator(input)) {
+            if (file.is_regular_file() && file.path().extension() == ".xml") {
+                entries.push_back({file.path().string(), std::nullopt, ""});
+            }
+        }
+        std::sort(entries.begin(), entries.end(), [](const BatchEntry& a, const BatchEntry& b) { return a.xml_file < b.xml_file; });
+        return entries;
+    }
+    std::ifstream manifest(input);
+    if (!manifest) {
+        throw std::runtime_error("Cannot open " + input);
+    }
+    fs::path base = fs::path(input).parent_path();
+    std::string line;
+    for (int line_no = 1; std::getline(manifest, line); ++line_no) {
+        std::istringstream ss(line.substr(0, line.find('#')));
+        std::string xml_file, collective, traffic_file;
+        if (!(ss >> xml_file)) {
+            continue;
+        }
+        BatchEntry entry{(base / xml_file).string(), std::nullopt, ""};
+        if (ss >> collective) {
+            try {
+                entry.kind = ParseCollectiveKind(collective);
+            } catch (const std::exception& e) {
+                throw std::runtime_error(input + ":" + std::to_string(line_no) + ": " + e.what());
+            }
+        }
+        if (ss >> traffic_file) {
+            entry.traffic_file = (base / traffic_file).string();
+        }
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+/**
+ * @brief Finds the collective of an XML from the manifest, its coll attribute and the options.
+ */
+static CollectiveKind ResolveKind(const BatchEntry& entry, const std::string& coll, const BatchOptions& options, std::string& traffic_file) {
+    traffic_file = entry.traffic_file;
+    std::filesystem::path sibling = entry.xml_file;
+    std::string sibling_traffic = sibling.replace_extension(".csv").string();
+    if (!std::filesystem::exists(sibling_traffic) && std::filesystem::exists(sibling.replace_extension(".bin"))) {
+        sibling_traffic = sibling.string();
+    }
+    CollectiveKind kind;
+    if (entry.kind) {
+        kind = *entry.kind;
+    } else if (coll == "allgather") {
+        kind = CollectiveKind::allgather;
+    } else if (coll == "reduce_scatter") {
+        kind = CollectiveKind::reducescatter;
+    } else if (options.collective) {
+        kind = *options.collective;
+    } else {
+        kind = std::filesystem::exists(sibling_traffic) ? CollectiveKind::alltoallv : CollectiveKind::allreduce;
+    }
+    if (coll != ExpectedCollAttribute(kind)) {
+        throw std::runtime_error(std::string("Expected coll=\"") + ExpectedCollAttribute(kind) + "\" for " + CollectiveKindName(kind) + ", got \"" + coll + "\"");
+    }
+    if (kind == CollectiveKind::alltoallv && traffic_file.empty()) {
+        traffic_file = sibling_traffic;
+    }
+    return kind;
+}
+
+static BatchResult VerifyEntry(const BatchEntry& entry, const BatchOptions& options, unsigned int seed, ThreadBlockBudget& budget) {
+    BatchResult result;
+    auto start = std::chrono::steady_clock::now();
+    tinyxml2::XMLDocument doc;
+    size_t reserved = 0;
+    try {
+        doc.LoadFile(entry.xml_file.c_str());
+        if (doc.Error()) {
+            throw std::runtime_error(std::string("Error loading XML file: ") + doc.ErrorIDToName(doc.ErrorID()));
+        }
+        tinyxml2::XMLElement* root_elem = doc.RootElement();
+        if (!root_elem) {
+            throw std::runtime_error("The XML has no root element.");
+        }
+        for (auto *gpu = root_elem->FirstChildElement("gpu"); gpu; gpu = gpu->NextSiblingElement("gpu")) {
+            result.num_tbs += gpu->ChildElementCount("tb");
+        }
+        auto queued = std::chrono::steady_clock::now();
+        reserved = budget.Acquire(result.num_tbs);
+        result.queue_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queued).count();
+
+        std::string traffic_file;
+        CollectiveKind kind = ResolveKind(entry, SafeGetAttribute(root_elem, "coll"), options, traffic_file);
+        result.collective = CollectiveKindName(kind);
+        auto comm_group = std::make_shared<CommGroup>();
+        comm_group->InitializeRanks(root_elem);
+        result.num_ranks = static_cast<int>(comm_group->getNumRanks());
+        if (!comm_group->getMailboxManager()->checkNoPendingConnections()) {
+            throw std::runtime_error("There are pending connections in the mailbox manager.\n" + comm_group->getMailboxManager()->DescribePendingConnections());
+        }
+        if (!comm_group->getMailboxManager()->checkChannelLayout()) {
+            throw std::runtime_error("Invalid channel layout in the mailbox manager.");
+        }
+        std::vector<size_t> traffic_matrix;
+        if (kind == CollectiveKind::alltoallv) {
+            traffic_matrix = ReadTrafficMatrix(traffic_file, result.num_ranks);
+        }
+        CollectiveSpec spec = MakeCollectiveSpec(kind, *comm_group, traffic_matrix);
+
+        result.status = BatchResult::Status::fail;
+        comm_group->Seed(seed);
+        for (; result.iters < options.iters; ++result.iters) {
+            comm_group->InitData(spec.init_func, spec.input_buff_size);
+            comm_group->ExecuteRanks();
+            comm_group->CheckData(spec.check_func, spec.output_buff_size);
+            if (!comm_group->getMailboxManager()->checkNoPendingMessage()) {
+                throw std::runtime_error("There are pending messages in the mailbox.");
+            }
+        }
+        result.status = BatchResult::Status::pass;
+    } catch (const std::exception& e) {
+        result.message = result.status == BatchResult::Status::fail ? "Iteration " + std::to_string(result.iters) + ": " + e.what() : e.what();
+    }
+    budget.Release(reserved);
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() - result.queue_ms;
+    return result;
+}
+
+static const char* StatusName(BatchResult::Status status) {
+    switch (status) {
+    case BatchResult::Status::pass:
+        return "PASS";
+    case BatchResult::Status::fail:
+        return "FAIL";
+    default:
+        return "ERROR";
+    }
+}
+
+static std::string JsonString(const std::string& s) {
+    std::ostringstream os;
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (c == '\n') {
+            os << "\\n";
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
+static void WriteJson(const std::vector<BatchEntry>& entries, const std::vector<BatchResult>& results, std::ostream& os) {
+    // One XML per line, like the results of scaling-bench
+    os << "{\"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult &r = results[i];
+        os << "  {\"xml\": " << JsonString(entries[i].xml_file) << ", \"status\": \"" << StatusName(r.status) << "\", \"collective\": \"" << r.collective
+           << "\", \"ranks\": " << r.num_ranks << ", \"threadblocks\": " << r.num_tbs << ", \"iters\": " << r.iters << ", \"wall_ms\": " << r.wall_ms
+           << ", \"queue_ms\": " << r.queue_ms           << ", \"message\": " << JsonString(r.message) << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]}\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    BatchOptions options;
+    std::vector<BatchEntry> entries;
+    try {
+        options = ParseBatchOptions(argc, argv);
+        entries = ListEntries(options.input);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    unsigned int seed = options.has_seed ? options.seed : std::random_device{}();
+    std::cout << "Verifying " << entries.size() << " XMLs with " << options.jobs << " jobs, seed " << seed << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchResult> results(entries.size());
+    ThreadBlockBudget budget(options.max_threadblocks);
+    std::atomic<size_t> next_entry{0};
+    std::vector<std::thread> workers;
+    for (int j = 0; j < std::min<int>(options.jobs, entries.size()); ++j) {
+        workers.emplace_back([&]() {
+            for (size_t i = next_entry++; i < entries.size(); i = next_entry++) {
+                results[i] = VerifyEntry(entries[i], options, seed, budget);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<BatchResult::Status, int> counts;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Status  Collective     Ranks  Threadblocks  Iters    Time(ms)   Queue(ms)  XML" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BatchResult &r = results[i];
+        counts[r.status]++;
+        std::cout << std::left << std::setw(8) << StatusName(r.status) << std::setw(13) << r.collective << std::right << std::setw(7) << r.num_ranks
+                  << std::setw(14) << r.num_tbs << std::setw(7) << r.iters << std::setw(12) << r.wall_ms << std::setw(12) << r.queue_ms << "  " << entries[i].xml_file << std::endl;
+        if (!r.message.empty()) {
+            std::cout << "        " << r.message << std::endl;
+        }
+    }
+    std::cout << std::setprecision(3) << "Verified " << entries.size() << " XMLs in " << wall_s << " s: " << counts[BatchResult::Status::pass] << " passed, "
+              << counts[BatchResult::Status::fail] << " failed, " << counts[BatchResult::Status::error] << " errors" << std::endl;
+    if (!options.output_file.empty()) {
+        std::ofstream out(options.output_file);
+        WriteJson(entries, results, out);
+        if (!out) {
+            std::cerr << "Error: Cannot write " << options.output_file << std::endl;
+            return 1;
+        }
+    }
+    return counts[BatchResult::Status::pass] == static_cast<int>(entries.size()) ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "chunk.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+ChunkDataType::ChunkDataType(int rank, size_t index): index(static_cast<uint32_t>(index)) {
+    if (rank < 0) {
+        throw std::runtime_error("Invalid source rank " + std::to_string(rank) + " of a chunk.");
+    }
+    Grow(rank / 64 + 1);
+    words()[rank / 64] |= uint64_t(1) << (rank % 64);
+}
+
+ChunkDataType ChunkDataType::RankRange(int first_rank, int num_ranks, size_t index) {
+    if (first_rank < 0 || num_ranks <= 0) {
+        throw std::runtime_error("Invalid source ranks of a chunk.");
+    }
+    ChunkDataType chunk(first_rank + num_ranks - 1, index);
+    uint64_t *w = chunk.words();
+    for (int rank = first_rank; rank < first_rank + num_ranks; ++rank) {
+        w[rank / 64] |= uint64_t(1) << (rank % 64);
+    }
+    return chunk;
+}
+
+const uint64_t* ChunkDataType::words() const {
+    return num_words <= INLINE_WORDS ? inline_words : heap_words.data();
+}
+
+uint64_t* ChunkDataType::words() {
+    return num_words <= INLINE_WORDS ? inline_words : heap_words.data();
+}
+
+void ChunkDataType::Grow(uint32_t new_num_words) {
+    if (new_num_words <= num_words) {
+        return;
+    }
+    if (new_num_words > INLINE_WORDS) {
+        if (num_words <= INLINE_WORDS) {
+            heap_words.assign(inline_words, inline_words + INLINE_WORDS);
+        }
+        heap_words.resize(new_num_words, 0);
+    }
+    num_words = new_num_words;
+}
+
+bool ChunkDataType::empty() const {
+    return num_words == 0;
+}
+
+size_t ChunkDataType::getIndex() const {
+    return index;
+}
+
+size_t ChunkDataType::countRanks() const {
+    size_t count = 0;
+    const uint64_t *w = words();
+    for (uint32_t i = 0; i < num_words; ++i) {
+        count += __builtin_popcountll(w[i]);
+    }
+    return count;
+}
+
+bool ChunkDataType::hasRank(int rank) const {
+    if (rank < 0 || static_cast<uint32_t>(rank / 64) >= num_words) {
+        return false;
+    }
+    return (words()[rank / 64] >> (rank % 64)) & 1;
+}
+
+ChunkDataType::ReduceStatus ChunkDataType::Reduce(const ChunkDataType& other) {
+    if (empty() || other.empty()) {
+        return ReduceStatus::empty_operand;
+    }
+    if (index != other.index) {
+        return ReduceStatus::index_mismatch;
+    }
+    // Both loops are plain word-wise bit operations that the compiler vectorizes
+    const uint64_t *b = other.words();
+    const uint64_t *a = words();
+    uint32_t common = std::min(num_words, other.num_words);
+    uint64_t overlap = 0;
+    for (uint32_t i = 0; i < common; ++i) {
+        overlap |= a[i] & b[i];
+    }
+    if (overlap != 0) {
+        return ReduceStatus::duplicate_contribution;
+    }
+    Grow(other.num_words);
+    uint64_t *w = words();
+    for (uint32_t i = 0; i < other.num_words; ++i) {
+        w[i] |= b[i];
+    }
+    return ReduceStatus::ok;
+}
+
+bool ChunkDataType::operator==(const ChunkDataType& other) const {
+    return num_words == other.num_words && (num_words == 0 || index == other.index) &&
+           memcmp(words(), other.words(), num_words * sizeof(uint64_t)) == 0;
+}
+
+bool ChunkDataType::operator!=(const ChunkDataType& other) const {
+    return !(*this == other);
+}
+
+std::string ChunkDataType::ToString() const {
+    if (empty()) {
+        return "";
+    }
+    int total_ranks = static_cast<int>(num_words) * 64;
+    std::string ranks;
+    size_t num_ranks = 0;
+    for (int rank = 0; rank < total_ranks; ++rank) {
+        if (!hasRank(rank)) {
+            continue;
+        }
+        int last = rank;
+        while (last + 1 < total_ranks && hasRank(last + 1)) {
+            ++last;
+        }
+        ranks += (ranks.empty() ? "" : ",") + std::to_string(rank);
+        if (last > rank) {
+            ranks += "-" + std::to_string(last);
+        }
+        num_ranks += last - rank + 1;
+        rank = last;
+    }
+    if (num_ranks > 1) {
+        ranks = "{" + ranks + "}";
+    }
+    return ranks + "_" + std::to_string(index);
+}
+
+void ChunkDataType::AppendWords(std::vector<uint64_t>& out) const {
+    out.push_back(static_cast<uint64_t>(num_words) << 32 | index);
+    out.insert(out.end(), words(), words() + num_words);
+}
+
+ChunkDataType ChunkDataType::ReadWords(const uint64_t* data, size_t& pos) {
+    ChunkDataType chunk;
+    chunk.index = static_cast<uint32_t>(data[pos]);
+    chunk.Grow(static_cast<uint32_t>(data[pos] >> 32));
+    std::copy(data + pos + 1, data + pos + 1 + chunk.num_words, chunk.words());
+    pos += 1 + chunk.num_words;
+    return chunk;
+}
+
+size_t ChunkDataType::MaxWords(int num_ranks) {
+    return 1 + (num_ranks + 63) / 64;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A symbolic chunk: the set of (rank, index) sources whose data it holds.
+ *
+ * All sources of a chunk share the same index into the input buffers, and the contributing
+ * ranks form a bitset. Copying moves a chunk as is; reducing two chunks ORs their rank sets,
+ * which detects duplicate contributions as overlapping bits. Bitsets of up to 128 ranks are
+ * stored inline. A default-constructed chunk is empty, i.e. never written.
+ */
+class ChunkDataType {
+public:
+    enum class ReduceStatus {
+        ok,
+        empty_operand,          // One of the chunks was never written
+        index_mismatch,         // The chunks hold different input indices
+        duplicate_contribution  // A rank contributes to both chunks
+    };
+
+    ChunkDataType() = default;
+    /**
+     * @brief The chunk at an index of the input buffer of a rank.
+     */
+    ChunkDataType(int rank, size_t index);
+    /**
+     * @brief The reduction of the chunks at an index of the input buffers of ranks [first_rank, first_rank + num_ranks).
+     */
+    static ChunkDataType RankRange(int first_rank, int num_ranks, size_t index);
+
+    bool empty() const;
+    size_t getIndex() const;
+    size_t countRanks() const;
+    bool hasRank(int rank) const;
+    /**
+     * @brief Reduces another chunk into this one. This chunk is unchanged unless ok is returned.
+     */
+    ReduceStatus Reduce(const ChunkDataType& other);
+
+    bool operator==(const ChunkDataType& other) const;
+    bool operator!=(const ChunkDataType& other) const;
+    /**
+     * @brief Formats the chunk as <rank>_<index>, or {<ranks>}_<index> for reductions, e.g. {0-3,6}_2.
+     * An empty chunk is formatted as an empty string.
+     */
+    std::string ToString() const;
+    /**
+     * @brief Appends the chunk to a sequence of words, e.g. to pass it to another process.
+     */
+    void AppendWords(std::vector<uint64_t>& out) const;
+    /**
+     * @brief Reads a chunk written by AppendWords at pos, and advances pos past it.
+     */
+    static ChunkDataType ReadWords(const uint64_t* data, size_t& pos);
+    /**
+     * @brief The most words AppendWords writes for a chunk whose ranks are below num_ranks.
+     */
+    static size_t MaxWords(int num_ranks);
+
+private:
+    static const uint32_t INLINE_WORDS = 2;
+
+    const uint64_t* words() const;
+    uint64_t* words();
+    /**
+     * @brief Grows the bitset to num_words words, zero-filling new words.
+     */
+    void Grow(uint32_t new_num_words);
+
+    uint32_t index = 0;
+    uint32_t num_words = 0; // The highest word is never zero; 0 iff the chunk is empty
+    uint64_t inline_words[INLINE_WORDS] = {0, 0};
+    std::vector<uint64_t> heap_words; // Used instead of inline_words if num_words > INLINE_WORDS
+};
@@ -0,0 +1,121 @@
+#include "collectives.hpp"
+#include "traffic.hpp"
+#include <algorithm>
+
+CollectiveKind ParseCollectiveKind(const std::string& name) {
+    for (CollectiveKind kind : {CollectiveKind::allgather, CollectiveKind::alltoall, CollectiveKind::alltoallv, CollectiveKind::allreduce, CollectiveKind::reducescatter}) {
+        if (name == CollectiveKindName(kind)) {
+            return kind;
+        }
+    }
+    throw std::runtime_error("Unknown collective " + name);
+}
+
+const char* CollectiveKindName(CollectiveKind kind) {
+    switch (kind) {
+    case CollectiveKind::allgather:
+        return "allgather";
+    case CollectiveKind::alltoall:
+        return "alltoall";
+    case CollectiveKind::alltoallv:
+        return "alltoallv";
+    case CollectiveKind::allreduce:
+        return "allreduce";
+    case CollectiveKind::reducescatter:
+        return "reducescatter";
+    }
+    return "";
+}
+
+const char* ExpectedCollAttribute(CollectiveKind kind) {
+    switch (kind) {
+    case CollectiveKind::allgather:
+        return "allgather";
+    case CollectiveKind::reducescatter:
+        return "reduce_scatter";
+    default:
+        return "allreduce";
+    }
+}
+
+/**
+ * @brief The spec of alltoallv: rank i sends a contiguous run of traffic(i, j) chunks of its input
+ * to rank j, which stores the runs it receives in the order of the senders.
+ *
+ * Expected chunks are computed on demand from the prefix sums rather than materialized, which
+ * keeps the spec at O(num_ranks^2) integers however large the chunk factor.
+ */
+static CollectiveSpec MakeAlltoallvSpec(const std::vector<size_t>& traffic_matrix, int num_ranks, size_t chunk_factor) {
+    if (traffic_matrix.size() != static_cast<size_t>(num_ranks) * num_ranks) {
+        throw std::runtime_error("The traffic matrix must have " + std::to_string(num_ranks) + " x " + std::to_string(num_ranks) + " entries.");
+    }
+    CheckTrafficSums(traffic_matrix, num_ranks, chunk_factor);
+    struct PrefixSums {
+        std::vector<size_t> send; // acc_row_sums: chunks rank i sends to ranks 0..j, at i * num_ranks + j
+        std::vector<size_t> recv; // Chunks rank j receives from ranks 0..i, at j * num_ranks + i
+    };
+    auto sums = std::make_shared<PrefixSums>();
+    sums->send.resize(traffic_matrix.size());
+    ComputeAccumulateRowSums(traffic_matrix.data(), sums->send.data(), num_ranks);
+    std::vector<size_t> acc_col_sums(traffic_matrix.size());
+    ComputeAccumulateColSums(traffic_matrix.data(), acc_col_sums.data(), num_ranks);
+    // Transposed, so the prefix sums of every receiver are contiguous for the binary search
+    sums->recv.resize(traffic_matrix.size());
+    for (int i = 0; i < num_ranks; ++i) {
+        for (int j = 0; j < num_ranks; ++j) {
+            sums->recv[j * num_ranks + i] = acc_col_sums[i * num_ranks + j];
+        }
+    }
+
+    const size_t num_chunks = num_ranks * chunk_factor;
+    auto init_func = [](int rank_id, size_t index) -> ChunkDataType {
+        return ChunkDataType(rank_id, index);
+    };
+    auto check_func = [sums, num_ranks](int rank_id, size_t index) -> ChunkDataType {
+        // The sender is the first rank whose prefix sum exceeds the index
+        const size_t *recv = sums->recv.data() + rank_id * num_ranks;
+        int sender = static_cast<int>(std::upper_bound(recv, recv + num_ranks, index) - recv);
+        size_t offset = index - (sender == 0 ? 0 : recv[sender - 1]);
+        size_t start_chunk = rank_id == 0 ? 0 : sums->send[sender * num_ranks + rank_id - 1];
+        return ChunkDataType(sender, start_chunk + offset);
+    };
+    return {init_func, num_chunks, check_func, num_chunks};
+}
+
+CollectiveSpec MakeCollectiveSpec(CollectiveKind kind, const CommGroup& comm_group, const std::vector<size_t>& traffic_matrix) {
+    const int num_ranks = static_cast<int>(comm_group.getNumRanks());
+    const size_t chunk_factor = comm_group.getChunkFactor();
+    const size_t num_chunks = comm_group.getNumChunks();
+    auto input_chunk = [](int rank_id, size_t index) -> ChunkDataType {
+        return ChunkDataType(rank_id, index);
+    };
+    switch (kind) {
+    case CollectiveKind::allgather:
+        return {[chunk_factor](int rank_id, size_t index) -> ChunkDataType {
+                    return ChunkDataType(rank_id, index % chunk_factor);
+                }, chunk_factor,
+                [chunk_factor](int rank_id, size_t index) -> ChunkDataType {
+                    return ChunkDataType(index / chunk_factor, index % chunk_factor);
+                }, num_chunks};
+    case CollectiveKind::alltoall:
+        return {input_chunk, num_chunks,
+                [chunk_factor](int rank_id, size_t index) -> ChunkDataType {
+                    return ChunkDataType(index / chunk_factor, rank_id * chunk_factor + index % chunk_factor);
+                }, num_chunks};
+    case CollectiveKind::alltoallv:
+        return MakeAlltoallvSpec(traffic_matrix, num_ranks, chunk_factor);
+    case CollectiveKind::allreduce:
+        // Every output chunk is the reduction of the chunks at its index across all ranks
+        return {input_chunk, num_chunks,
+                [num_ranks](int rank_id, size_t index) -> ChunkDataType {
+                    return ChunkDataType::RankRange(0, num_ranks, index);
+                }, num_chunks};
+    case CollectiveKind::reducescatter:
+        // Rank r ends up with the reduction of the r-th slice of chunk_factor chunks across all ranks
+        return {input_chunk, num_chunks,
+                [num_ranks, chunk_factor](int rank_id, size_t index) -> ChunkDataType {
+                    return ChunkDataType::RankRange(0, num_ranks, rank_id * chunk_factor + index);
+                }, chunk_factor};
+    }
+    throw std::runtime_error("Unknown collective");
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "driver.hpp"
+#include <string>
+#include <vector>
+
+enum class CollectiveKind {
+    allgather,
+    alltoall,
+    alltoallv,
+    allreduce,
+    reducescatter
+};
+
+CollectiveKind ParseCollectiveKind(const std::string& name);
+const char* CollectiveKindName(CollectiveKind kind);
+/**
+ * @brief Returns the coll attribute the XML of a collective must have.
+ * Not a typo: the all-to-all verifiers expect "allreduce", the collective name used by CCF.
+ */
+const char* ExpectedCollAttribute(CollectiveKind kind);
+
+/**
+ * @brief Describes the buffers of a collective on an initialized CommGroup.
+ * @param traffic_matrix Chunks from rank i to rank j at i * num_ranks + j; only used by alltoallv.
+ * Throws if the traffic matrix does not match the chunk factor of the group.
+ */
+CollectiveSpec MakeCollectiveSpec(CollectiveKind kind, const CommGroup& comm_group, const std::vector<size_t>& traffic_matrix = {});
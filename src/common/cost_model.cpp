@@ -0,0 +1,94 @@
+#include "cost_model.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+double LinkCost::TransferTime(double bytes) const {
+    return alpha_us + bytes / (bandwidth_gbps * 1e3);
+}
+
+static std::string Trim(const std::string& str) {
+    size_t begin = str.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(begin, end - begin + 1);
+}
+
+CostModel CostModel::Load(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Cannot open cost model file " + file);
+    }
+    CostModel model;
+    std::string line;
+    for (int line_no = 1; std::getline(in, line); ++line_no) {
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) {
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Expected key = value in line " + std::to_string(line_no) + " of " + file);
+        }
+        std::string key = Trim(line.substr(0, eq));
+        std::string value = Trim(line.substr(eq + 1));
+        if (key == "ranks_per_node") {
+            model.ranks_per_node = std::stoi(value);
+            if (model.ranks_per_node <= 0) {
+                throw std::runtime_error("ranks_per_node must be positive in " + file);
+            }
+            continue;
+        }
+        size_t dot = key.find('.');
+        std::string link = key.substr(0, dot);
+        LinkCost *cost = link == "local" ? &model.local : link == "intra" ? &model.intra_node : link == "inter" ? &model.inter_node : nullptr;
+        std::string field = dot == std::string::npos ? "" : key.substr(dot + 1);
+        if (cost && field == "alpha_us") {
+            cost->alpha_us = std::stod(value);
+        } else if (cost && field == "bandwidth_gbps") {
+            cost->bandwidth_gbps = std::stod(value);
+            if (cost->bandwidth_gbps <= 0) {
+                throw std::runtime_error("Bandwidth must be positive in line " + std::to_string(line_no) + " of " + file);
+            }
+        } else {
+            throw std::runtime_error("Unknown key " + key + " in line " + std::to_string(line_no) + " of " + file);
+        }
+    }
+    return model;
+}
+
+LinkClass CostModel::Classify(int src_rank, int dst_rank) const {
+    if (src_rank == dst_rank) {
+        return LinkClass::local;
+    }
+    return (src_rank / ranks_per_node == dst_rank / ranks_per_node) ? LinkClass::intra_node : LinkClass::inter_node;
+}
+
+const LinkCost& CostModel::getCost(LinkClass link) const {
+    switch (link) {
+        case LinkClass::local: return local;
+        case LinkClass::intra_node: return intra_node;
+        case LinkClass::inter_node: return inter_node;
+    }
+    return local;
+}
+
+std::string CostModel::ToString() const {
+    std::ostringstream os;
+    os << ranks_per_node << " ranks per node";
+    for (LinkClass link : {LinkClass::local, LinkClass::intra_node, LinkClass::inter_node}) {
+        os << ", " << link << " " << getCost(link).alpha_us << " us + " << getCost(link).bandwidth_gbps << " GB/s";
+    }
+    return os.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const LinkClass& link) {
+    switch (link) {
+        case LinkClass::local: os << "local"; break;
+        case LinkClass::intra_node: os << "intra"; break;
+        case LinkClass::inter_node: os << "inter"; break;
+    }
+    return os;
+}
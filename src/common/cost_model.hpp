@@ -0,0 +1,42 @@
+#pragma once
+#include <iostream>
+#include <string>
+
+enum class LinkClass {
+    local,      // Within a GPU: cpy, re and copying a received message out of its buffer
+    intra_node, // Between GPUs of a node, e.g. over NVLink
+    inter_node  // Between nodes over the network
+};
+
+/**
+ * @brief Alpha-beta cost of a transfer: a fixed latency plus the bytes over the bandwidth.
+ */
+struct LinkCost {
+    double alpha_us;
+    double bandwidth_gbps; // GB/s, i.e. 1e3 bytes per microsecond
+
+    double TransferTime(double bytes) const;
+};
+
+/**
+ * @brief Costs of the link classes, and which ranks share a node.
+ *
+ * A configuration file holds one "key = value" per line; # starts a comment. The keys are
+ * ranks_per_node and <class>.alpha_us and <class>.bandwidth_gbps, where class is local, intra
+ * or inter. Keys that are not given keep their defaults.
+ */
+class CostModel {
+public:
+    static CostModel Load(const std::string& file);
+
+    LinkClass Classify(int src_rank, int dst_rank) const;
+    const LinkCost& getCost(LinkClass link) const;
+    std::string ToString() const;
+
+    int ranks_per_node = 8;
+    LinkCost local = {0.5, 1000.0};
+    LinkCost intra_node = {1.5, 150.0};
+    LinkCost inter_node = {5.0, 25.0};
+};
+
+std::ostream& operator<<(std::ostream& os, const LinkClass& link);
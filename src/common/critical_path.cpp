@@ -0,0 +1,72 @@
+#include "critical_path.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+CriticalPath FindCriticalPath(const ExecGraph& graph, const TimingResult& result) {
+    CriticalPath path;
+    const size_t num_nodes = graph.getNumNodes();
+    if (num_nodes == 0) {
+        return path;
+    }
+
+    int node = static_cast<int>(std::max_element(result.finish_us.begin(), result.finish_us.end()) - result.finish_us.begin());
+    while (node >= 0) {
+        path.nodes.push_back(node);
+        int binding = -1;
+        for (const int *p = graph.PredecessorsBegin(node); p != graph.PredecessorsEnd(node); ++p) {
+            if (binding < 0 || result.finish_us[*p] >= result.finish_us[binding]) {
+                binding = *p;
+            }
+        }
+        node = binding;
+    }
+    std::reverse(path.nodes.begin(), path.nodes.end());
+
+    // Latest finish times in reverse topological order
+    std::vector<int> order = graph.TopologicalOrder();
+    std::vector<double> latest_finish(num_nodes, result.makespan_us);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        int n = *it;
+        for (const int *s = graph.SuccessorsBegin(n); s != graph.SuccessorsEnd(n); ++s) {
+            double latest_start = latest_finish[*s] - (result.finish_us[*s] - result.start_us[*s]);
+            latest_finish[n] = std::min(latest_finish[n], latest_start);
+        }
+    }
+    path.slack_us.resize(num_nodes);
+    for (size_t n = 0; n < num_nodes; ++n) {
+        path.slack_us[n] = std::max(0.0, latest_finish[n] - result.finish_us[n]);
+    }
+    return path;
+}
+
+void PrintCriticalPath(const ExecGraph& graph, const TimingResult& result, const CriticalPath& path, std::ostream& os) {
+    os << std::fixed << std::setprecision(3);
+    os << "Critical path: " << path.nodes.size() << " steps, " << result.makespan_us << " us" << std::endl;
+    os << "  Rank    TB  Step  Op       Start(us)  Duration(us)" << std::endl;
+    for (int node : path.nodes) {
+        const ExecGraph::Node &n = graph.getNode(node);
+        std::ostringstream op;
+        op << n.op;
+        os << std::setw(6) << n.rank << std::setw(6) << n.tbid << std::setw(6) << n.step << "  " << std::left << std::setw(6) << op.str() << std::right
+           << std::setw(12) << result.start_us[node] << std::setw(14) << result.finish_us[node] - result.start_us[node] << std::endl;
+    }
+    std::vector<bool> on_path(graph.getNumNodes(), false);
+    for (int node : path.nodes) {
+        on_path[node] = true;
+    }
+    os << "Threadblock slack (* = on the critical path):" << std::endl;
+    os << "  Rank    TB   Slack(us)" << std::endl;
+    for (size_t r = 0; r < graph.getNumRanks(); ++r) {
+        for (size_t t = 0; t < graph.getNumThreadBlocks(r); ++t) {
+            double slack = result.makespan_us;
+            bool critical = false;
+            for (size_t n = graph.getFirstNode(r, t); n < graph.getEndNode(r, t); ++n) {
+                slack = std::min(slack, path.slack_us[n]);
+                critical = critical || on_path[n];
+            }
+            os << std::setw(6) << r << std::setw(6) << t << std::setw(12) << slack << (critical ? " *" : "") << std::endl;
+        }
+    }
+    os << std::defaultfloat;
+}
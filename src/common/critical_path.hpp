@@ -0,0 +1,27 @@
+#pragma once
+#include "timing.hpp"
+
+/**
+ * @brief The chain of steps that determines the completion time of a timing simulation.
+ */
+struct CriticalPath {
+    std::vector<int> nodes;       // From the first step to the last one to finish
+    std::vector<double> slack_us; // Per node: how much it can finish later without delaying the end
+};
+
+/**
+ * @brief Finds the critical path and the slack of every step in time linear in the graph size.
+ *
+ * The path is traced back from the last step to finish, each time through the predecessor that
+ * finished last; on ties, a dependency or matched send is preferred over program order. Slack
+ * is the latest finish time that does not delay the end (the earliest latest start among its
+ * successors) minus the modeled finish time. Under link contention, steps keep their simulated
+ * durations, so slack ignores how the sharing would change.
+ */
+CriticalPath FindCriticalPath(const ExecGraph& graph, const TimingResult& result);
+
+/**
+ * @brief Prints the steps of the critical path and the slack of every threadblock, which is
+ * the smallest slack of its steps.
+ */
+void PrintCriticalPath(const ExecGraph& graph, const TimingResult& result, const CriticalPath& path, std::ostream& os);
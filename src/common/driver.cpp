@@ -0,0 +1,641 @@
+#include "driver.hpp"
+#include "collectives.hpp"
+#include "critical_path.hpp"
+#include "minimizer.hpp"
+#include "scheduler.hpp"
+#include "shm_transport.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static bool MatchFlag(const char* arg, const char* name) {
+    return strcmp(arg, name) == 0;
+}
+
+static bool MatchOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+/**
+ * @brief Parses a byte count with an optional K, M or G (binary) suffix.
+ */
+static size_t ParseBytes(const std::string& value) {
+    size_t pos = 0;
+    size_t bytes = std::stoull(value, &pos);
+    std::string suffix = value.substr(pos);
+    if (suffix == "K") {
+        bytes <<= 10;
+    } else if (suffix == "M") {
+        bytes <<= 20;
+    } else if (suffix == "G") {
+        bytes <<= 30;
+    } else if (!suffix.empty()) {
+        throw std::runtime_error("Invalid byte count " + value);
+    }
+    return bytes;
+}
+
+VerifierOptions ParseVerifierOptions(int argc, char* argv[], int first_option) {
+    VerifierOptions options;
+    for (int i = first_option; i < argc; ++i) {
+        std::string value;
+        if (MatchOption(argv[i], "--scheduler", value)) {
+            if (value == "threads") {
+                options.scheduler = VerifierOptions::Scheduler::threads;
+            } else if (value == "pct") {
+                options.scheduler = VerifierOptions::Scheduler::pct;
+            } else {
+                throw std::runtime_error("Unknown scheduler " + value);
+            }
+        } else if (MatchOption(argv[i], "--pct-depth", value)) {
+            options.pct_depth = std::stoi(value);
+        } else if (MatchOption(argv[i], "--seed", value)) {
+            options.has_seed = true;
+            options.seed = std::stoul(value);
+        } else if (MatchOption(argv[i], "--record", value)) {
+            options.record_file = value;
+        } else if (MatchOption(argv[i], "--replay", value)) {
+            options.replay_file = value;
+        } else if (MatchOption(argv[i], "--minimize", value)) {
+            options.minimize_file = value;
+        } else if (MatchOption(argv[i], "--timeline", value)) {
+            options.timeline_file = value;
+        } else if (MatchFlag(argv[i], "--provenance")) {
+            options.provenance = true;
+        } else if (MatchFlag(argv[i], "--mailbox-stats")) {
+            options.mailbox_stats = true;
+        } else if (MatchFlag(argv[i], "--wait-stats")) {
+            options.wait_stats = true;
+        } else if (MatchFlag(argv[i], "--perf-counters")) {
+            options.perf_counters = true;
+        } else if (MatchOption(argv[i], "--simulate", value)) {
+            options.simulate_bytes = ParseBytes(value);
+            if (options.simulate_bytes == 0) {
+                throw std::runtime_error("--simulate requires a positive buffer size");
+            }
+        } else if (MatchOption(argv[i], "--sim-config", value)) {
+            options.sim_config_file = value;
+        } else if (MatchOption(argv[i], "--topology", value)) {
+            options.topology_file = value;
+        } else if (MatchFlag(argv[i], "--critical-path")) {
+            options.critical_path = true;
+        } else if (MatchOption(argv[i], "--numa", value)) {
+            if (value == "report") {
+                options.numa = VerifierOptions::Numa::report;
+            } else if (value == "place") {
+                options.numa = VerifierOptions::Numa::place;
+            } else {
+                throw std::runtime_error("Unknown NUMA mode " + value);
+            }
+        } else if (MatchOption(argv[i], "--replicas", value)) {
+            options.num_replicas = std::stoi(value);
+            if (options.num_replicas < 1) {
+                throw std::runtime_error("--replicas requires at least one replica");
+            }
+        } else if (MatchOption(argv[i], "--processes", value)) {
+            options.num_processes = std::stoi(value);
+            if (options.num_processes < 1) {
+                throw std::runtime_error("--processes requires at least one process");
+            }
+        } else {
+            throw std::runtime_error("Unknown option " + std::string(argv[i]));
+        }
+    }
+    if (!options.minimize_file.empty() && options.replay_file.empty()) {
+        throw std::runtime_error("--minimize requires a trace given by --replay");
+    }
+    if ((!options.sim_config_file.empty() || !options.topology_file.empty() || options.critical_path) && options.simulate_bytes == 0) {
+        throw std::runtime_error("--sim-config, --topology and --critical-path require --simulate");
+    }
+    if (options.num_processes > 1 && (options.scheduler != VerifierOptions::Scheduler::threads || !options.record_file.empty() || !options.replay_file.empty() ||
+                                      !options.timeline_file.empty() || options.provenance || options.mailbox_stats || options.wait_stats ||
+                                      options.simulate_bytes > 0)) {
+        throw std::runtime_error("--processes cannot be combined with --scheduler=pct, --record, --replay, --timeline, --provenance, --mailbox-stats, --wait-stats or --simulate");
+    }
+    if (options.num_replicas > 1 && (options.scheduler != VerifierOptions::Scheduler::threads || !options.record_file.empty() || !options.replay_file.empty() ||
+                                     !options.timeline_file.empty() || options.mailbox_stats || options.wait_stats || options.simulate_bytes > 0 ||
+                                     options.num_processes > 1 || options.numa != VerifierOptions::Numa::off)) {
+        throw std::runtime_error("--replicas cannot be combined with --scheduler=pct, --record, --replay, --timeline, --mailbox-stats, --wait-stats, --simulate, --processes or --numa");
+    }
+    return options;
+}
+
+std::string VerifierOptionsUsage() {
+    return "Options:\n"
+           "  --scheduler=threads|pct  Run threadblocks as CPU threads (default) or under the serial PCT scheduler\n"
+           "  --pct-depth=<d>          Bug depth targeted by the PCT scheduler (default 3)\n"
+           "  --seed=<n>               Seed for all random decisions (default: random, printed at start)\n"
+           "  --record=<file>          Write the schedule of the first failing (or the last) iteration to a trace file\n"
+           "  --replay=<file>          Re-execute a recorded schedule on a single thread instead of running iterations\n"
+           "  --minimize=<file>        Shrink the failing schedule given by --replay and write the result to a trace file\n"
+           "  --timeline=<file>        Write a Chrome trace of the first failing (or the last) iteration, one track per threadblock\n"
+           "  --provenance             Track the path of every chunk and print it on data mismatches\n"
+           "  --mailbox-stats          Print the messages, chunks, queue depth and residency of every mailbox at the end\n"
+           "  --wait-stats             Print where the time of the threadblocks went at the end\n"
+           "  --perf-counters          Report cycles, instructions, cache misses and context switches per phase\n"
+           "  --simulate=<bytes>       Estimate the completion time for a buffer size (K/M/G suffixes) instead of running iterations\n"
+           "  --sim-config=<file>      Link costs of the timing simulation (default: built-in costs)\n"
+           "  --topology=<file>        Share the bandwidth of physical links among concurrent transfers in the timing simulation\n"
+           "  --critical-path          Print the critical path and the slack of every threadblock of the timing simulation\n"
+           "  --processes=<n>          Split the ranks over n worker processes connected by shared-memory mailboxes (default 1)\n"
+           "  --numa=report|place      Report remote pages of buffers and mailboxes; place also pins ranks to NUMA nodes\n"
+           "  --replicas=<k>           Run iterations concurrently on k independent copies of the ranks (default 1)\n";
+}
+
+/**
+ * @brief Runs one iteration on the schedule of a trace file.
+ */
+static int ReplayTrace(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, const std::string& replay_file) {
+    try {
+        ScheduleTrace trace = ScheduleTrace::Load(replay_file);
+        std::cout << "Replaying iteration " << trace.iteration << " (seed " << trace.seed << ", " << trace.entries.size() << "/" << trace.total_steps << " steps recorded)" << std::endl;
+        comm_group->InitData(spec.init_func, spec.input_buff_size);
+        ReplaySchedule(comm_group, trace);
+        comm_group->CheckData(spec.check_func, spec.output_buff_size);
+        if (!comm_group->getMailboxManager()->checkNoPendingMessage()) {
+            throw std::runtime_error("There are pending messages in the mailbox after the replay.");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Replay passed." << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Minimizes the failing schedule of a trace file.
+ */
+static int MinimizeTrace(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, const std::string& replay_file, const std::string& minimize_file) {
+    try {
+        ScheduleTrace trace = ScheduleTrace::Load(replay_file);
+        ScheduleMinimizer minimizer(comm_group, spec, std::thread::hardware_concurrency());
+        minimizer.Minimize(trace, std::cout).Save(minimize_file);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Minimized schedule written to " << minimize_file << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Estimates the completion time of the XML with the alpha-beta cost model.
+ */
+static int SimulateTiming(std::shared_ptr<CommGroup> comm_group, const VerifierOptions& options) {
+    try {
+        CostModel cost_model = options.sim_config_file.empty() ? CostModel() : CostModel::Load(options.sim_config_file);
+        double chunk_bytes = static_cast<double>(options.simulate_bytes) / comm_group->getNumChunks();
+        std::cout << "Simulating " << options.simulate_bytes << " bytes (" << chunk_bytes << " bytes per chunk) with " << cost_model.ToString() << std::endl;
+        std::unique_ptr<Topology> topology;
+        if (!options.topology_file.empty()) {
+            topology = std::make_unique<Topology>(Topology::Load(options.topology_file));
+            std::cout << "Topology with " << topology->getNumLinks() << " links from " << options.topology_file << std::endl;
+        }
+        ExecGraph graph(comm_group);
+        TimingSimulator simulator(graph, cost_model, chunk_bytes, topology.get());
+        TimingResult result = simulator.Run();
+        simulator.PrintReport(result, std::cout);
+        if (options.critical_path) {
+            PrintCriticalPath(graph, result, FindCriticalPath(graph, result), std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints how long the iteration loop took, excluding loading the XML and the reports after it.
+ */
+static void PrintIterationRate(int run_iters, std::chrono::steady_clock::duration elapsed, std::ostream& os) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    os << std::fixed << std::setprecision(3) << "Ran " << run_iters << " iterations in " << seconds << " s (" << (seconds > 0 ? run_iters / seconds : 0.0)
+       << " iterations/s)" << std::endl << std::defaultfloat;
+}
+
+/**
+ * @brief Outcome of one worker process, written to shared memory before it exits.
+ */
+struct WorkerResult {
+    int32_t failed;
+    char message[1024];
+};
+
+/**
+ * @brief Runs every iteration in worker processes, each executing and checking a contiguous group of ranks.
+ *
+ * Mailboxes between ranks of different workers pass messages through rings in one shared memory
+ * segment, sized for all messages of an iteration, so a sender never waits for room. Workers are
+ * forked for every iteration, so they all start from the data of InitData in the coordinator.
+ */
+static int RunProcesses(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, int run_iters, const VerifierOptions& options,
+                        unsigned int seed, const NumaTopology* topology, PhaseProfiler* profiler) {
+    const int num_ranks = static_cast<int>(comm_group->getNumRanks());
+    const int num_processes = options.num_processes;
+    if (num_processes > num_ranks) {
+        std::cerr << "Error: Cannot split " << num_ranks << " ranks over " << num_processes << " processes." << std::endl;
+        return 1;
+    }
+    std::vector<int> first_rank(num_processes + 1), owner(num_ranks);
+    for (int p = 0; p <= num_processes; ++p) {
+        first_rank[p] = static_cast<int>(static_cast<int64_t>(num_ranks) * p / num_processes);
+    }
+    for (int p = 0; p < num_processes; ++p) {
+        std::fill(owner.begin() + first_rank[p], owner.begin() + first_rank[p + 1], p);
+    }
+
+    // Size a ring for every mailbox crossing workers by the messages its sender sends in an iteration
+    std::vector<std::pair<std::shared_ptr<Mailbox>, size_t>> shared_mailboxes;
+    size_t segment_size = num_processes * sizeof(WorkerResult);
+    for (int r = 0; r < num_ranks; ++r) {
+        auto rank = comm_group->getRank(r);
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            auto tb = rank->getThreadBlock(t);
+            if (tb->getSendPeer() < 0 || !tb->getSendMailbox() || owner[r] == owner[tb->getSendPeer()]) {
+                continue;
+            }
+            size_t capacity = 0;
+            for (const auto& inst : tb->getInstructions()) {
+                if (IsSendOp(inst.op)) {
+                    capacity += MaxMessageWords(inst.num_chunks, num_ranks);
+                }
+            }
+            segment_size = (segment_size + 63) / 64 * 64;
+            shared_mailboxes.push_back({tb->getSendMailbox(), segment_size});
+            segment_size += SharedRing::RegionSize(capacity);
+        }
+    }
+    std::unique_ptr<SharedMemorySegment> segment;
+    std::vector<SharedRing> rings;
+    try {
+        segment = std::make_unique<SharedMemorySegment>(segment_size);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    char *base = static_cast<char*>(segment->data());
+    WorkerResult *results = reinterpret_cast<WorkerResult*>(base);
+    rings.reserve(shared_mailboxes.size());
+    for (size_t m = 0; m < shared_mailboxes.size(); ++m) {
+        size_t end = m + 1 < shared_mailboxes.size() ? shared_mailboxes[m + 1].second : segment_size;
+        size_t capacity = (end - shared_mailboxes[m].second - SharedRing::RegionSize(0)) / sizeof(uint64_t);
+        rings.emplace_back(base + shared_mailboxes[m].second, capacity);
+        shared_mailboxes[m].first->AttachRing(&rings.back());
+    }
+    std::cout << "Running " << num_processes << " worker processes, " << rings.size() << " mailboxes in " << segment_size << " bytes of shared memory" << std::endl;
+
+    auto start_time = std::chrono::steady_clock::now();
+    int i = 0;
+    try {
+        for (; i < run_iters; i++) {
+            if (i % 10 == 0) {
+                std::cout << "Running iteration " << i << "/" << run_iters << std::endl;
+            }
+            comm_group->InitData(spec.init_func, spec.input_buff_size);
+            for (auto& ring : rings) {
+                ring.Reset();
+            }
+            memset(results, 0, num_processes * sizeof(WorkerResult));
+            std::cout.flush();
+            std::cerr.flush();
+            profiler->Begin("ExecuteRanks");
+            std::vector<pid_t> workers;
+            for (int p = 0; p < num_processes; ++p) {
+                pid_t pid = fork();
+                if (pid < 0) {
+                    results[p].failed = 1;
+                    snprintf(results[p].message, sizeof(results[p].message), "Cannot fork: %s", strerror(errno));
+                    break;
+                }
+                if (pid == 0) {
+                    WorkerResult &result = results[p];
+                    try {
+                        std::seed_seq seed_seq{seed, static_cast<unsigned int>(i), static_cast<unsigned int>(p)};
+                        unsigned int worker_seed;
+                        seed_seq.generate(&worker_seed, &worker_seed + 1);
+                        comm_group->Seed(worker_seed);
+                        comm_group->ExecuteRanks(first_rank[p], first_rank[p + 1]);
+                        comm_group->CheckData(spec.check_func, spec.output_buff_size, first_rank[p], first_rank[p + 1]);
+                        if (!comm_group->getMailboxManager()->checkNoPendingMessage(false)) {
+                            throw std::runtime_error("There are pending messages in the mailbox.");
+                        }
+                    } catch (const std::exception& e) {
+                        result.failed = 1;
+                        strncpy(result.message, e.what(), sizeof(result.message) - 1);
+                    }
+                    _exit(result.failed);
+                }
+                workers.push_back(pid);
+            }
+            for (size_t p = 0; p < workers.size(); ++p) {
+                int status = 0;
+                waitpid(workers[p], &status, 0);
+                if (!results[p].failed && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+                    results[p].failed = 1;
+                    snprintf(results[p].message, sizeof(results[p].message), "Terminated %s %d.", WIFSIGNALED(status) ? "by signal" : "with exit code",
+                             WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+                }
+            }
+            profiler->End();
+            for (int p = 0; p < num_processes; ++p) {
+                if (results[p].failed) {
+                    throw std::runtime_error("Worker " + std::to_string(p) + " (ranks " + std::to_string(first_rank[p]) + "-" + std::to_string(first_rank[p + 1] - 1) +
+                                             "): " + results[p].message);
+                }
+            }
+            if (!comm_group->getMailboxManager()->checkNoPendingMessage()) {
+                throw std::runtime_error("There are pending messages in the mailbox after iteration " + std::to_string(i) + ".");
+            }
+        }
+    } catch (const std::exception& e) {
+        profiler->End();
+        profiler->Print(std::cout);
+        std::cerr << "Error in iteration " << i << ": " << e.what() << std::endl;
+        return 1;
+    }
+    PrintIterationRate(run_iters, std::chrono::steady_clock::now() - start_time, std::cout);
+    if (topology) {
+        comm_group->PrintNumaPlacement(*topology, std::cout);
+    }
+    profiler->Print(std::cout);
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Runs the iterations concurrently on independent replicas of the CommGroup.
+ *
+ * Every replica takes the next iteration that is not taken yet, so fast replicas run more of
+ * them. Each iteration is seeded from the seed and its number, so the seed printed with a
+ * failure is the same whichever replica ran it. Failing iterations do not stop the others; all
+ * of them are counted and the first few are printed.
+ */
+static int RunReplicas(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, int run_iters, const VerifierOptions& options,
+                       unsigned int seed, PhaseProfiler* profiler) {
+    struct Failure {
+        int iteration;
+        unsigned int seed;
+        std::string message;
+    };
+    const size_t max_failures_shown = 5;
+    std::vector<std::shared_ptr<CommGroup>> replicas{comm_group};
+    for (int k = 1; k < options.num_replicas; ++k) {
+        replicas.push_back(comm_group->CreateReplica());
+        replicas.back()->EnableProvenance(options.provenance);
+    }
+    std::cout << "Running " << replicas.size() << " replicas" << std::endl;
+
+    std::atomic<int> next_iter{0};
+    std::mutex mutex; // Protects failures and std::cout
+    std::vector<Failure> failures;
+    auto start_time = std::chrono::steady_clock::now();
+    profiler->Begin("ExecuteRanks");
+    std::vector<std::thread> threads;
+    for (auto& replica : replicas) {
+        threads.emplace_back([&, replica]() {
+            for (int i = next_iter++; i < run_iters; i = next_iter++) {
+                std::seed_seq seed_seq{seed, static_cast<unsigned int>(i)};
+                unsigned int iter_seed;
+                seed_seq.generate(&iter_seed, &iter_seed + 1);
+                if (i % 10 == 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::cout << "Running iteration " << i << "/" << run_iters << std::endl;
+                }
+                try {
+                    replica->Seed(iter_seed);
+                    replica->InitData(spec.init_func, spec.input_buff_size);
+                    replica->ExecuteRanks();
+                    replica->CheckData(spec.check_func, spec.output_buff_size);
+                    if (!replica->getMailboxManager()->checkNoPendingMessage()) {
+                        throw std::runtime_error("There are pending messages in the mailbox after iteration " + std::to_string(i) + ".");
+                    }
+                } catch (const std::exception& e) {
+                    replica->getMailboxManager()->ClearMessages();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failures.push_back({i, iter_seed, e.what()});
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    profiler->End();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    std::cout << std::fixed << std::setprecision(3) << "Ran " << run_iters << " iterations on " << replicas.size() << " replicas in " << seconds << " s ("
+              << (seconds > 0 ? run_iters / seconds : 0.0) << " iterations/s)" << std::endl << std::defaultfloat;
+    profiler->Print(std::cout);
+    if (!failures.empty()) {
+        std::sort(failures.begin(), failures.end(), [](const Failure& a, const Failure& b) { return a.iteration < b.iteration; });
+        for (size_t f = 0; f < std::min(failures.size(), max_failures_shown); ++f) {
+            std::cerr << "Error in iteration " << failures[f].iteration << " (seed " << failures[f].seed << "): " << failures[f].message << std::endl;
+        }
+        std::cerr << failures.size() << " of " << run_iters << " iterations failed." << std::endl;
+        return 1;
+    }
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
+
+int RunIterations(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, int run_iters, const VerifierOptions& options,
+                  PhaseProfiler* profiler) {
+    PhaseProfiler disabled_profiler(false);
+    if (!profiler) {
+        profiler = &disabled_profiler;
+    }
+    comm_group->EnableProvenance(options.provenance);
+    comm_group->EnableWaitStats(options.wait_stats);
+    comm_group->getMailboxManager()->EnableStats(options.mailbox_stats);
+    if (options.simulate_bytes > 0) {
+        return SimulateTiming(comm_group, options);
+    }
+    if (!options.minimize_file.empty()) {
+        return MinimizeTrace(comm_group, spec, options.replay_file, options.minimize_file);
+    }
+    if (!options.replay_file.empty()) {
+        return ReplayTrace(comm_group, spec, options.replay_file);
+    }
+
+    unsigned int seed = options.has_seed ? options.seed : std::random_device{}();
+    std::cout << "Seed: " << seed << std::endl;
+    comm_group->Seed(seed);
+    std::shared_ptr<NumaTopology> topology;
+    if (options.numa != VerifierOptions::Numa::off) {
+        topology = std::make_shared<NumaTopology>(NumaTopology::Detect());
+        if (options.numa == VerifierOptions::Numa::place) {
+            try {
+                comm_group->PlaceOnNumaNodes(topology);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (options.num_processes > 1) {
+        return RunProcesses(comm_group, spec, run_iters, options, seed, topology.get(), profiler);
+    }
+    if (options.num_replicas > 1) {
+        return RunReplicas(comm_group, spec, run_iters, options, seed, profiler);
+    }
+    std::unique_ptr<PctScheduler> pct;
+    if (options.scheduler == VerifierOptions::Scheduler::pct) {
+        pct = std::make_unique<PctScheduler>(options.pct_depth, seed);
+        pct->PrintBound(comm_group, std::cout);
+    }
+    std::shared_ptr<ScheduleRecorder> recorder;
+    if (!options.record_file.empty()) {
+        recorder = std::make_shared<ScheduleRecorder>(comm_group->getNumRanks(), comm_group->getNumSteps());
+        comm_group->SetScheduleRecorder(recorder);
+    }
+    std::shared_ptr<Tracer> tracer;
+    if (!options.timeline_file.empty()) {
+        tracer = std::make_shared<Tracer>(*comm_group);
+        comm_group->SetTracer(tracer);
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    int i = 0;
+    try {
+        for (; i < run_iters; i++) {
+            if (i % 10 == 0) {
+                std::cout << "Running iteration " << i << "/" << run_iters << std::endl;
+            }
+            if (recorder) {
+                recorder->Reset();
+            }
+            if (tracer) {
+                tracer->Reset();
+            }
+            comm_group->InitData(spec.init_func, spec.input_buff_size);
+            profiler->Begin("ExecuteRanks");
+            if (pct) {
+                pct->ExecuteRanks(comm_group);
+            } else {
+                comm_group->ExecuteRanks();
+            }
+            profiler->End();
+            profiler->Begin("CheckData");
+            comm_group->CheckData(spec.check_func, spec.output_buff_size);
+            profiler->End();
+            if (!comm_group->getMailboxManager()->checkNoPendingMessage()) {
+                throw std::runtime_error("There are pending messages in the mailbox after iteration " + std::to_string(i) + ".");
+            }
+        }
+    } catch (const std::exception& e) {
+        profiler->End();
+        if (options.wait_stats) {
+            comm_group->PrintWaitStats(std::cout);
+        }
+        if (options.mailbox_stats) {
+            comm_group->getMailboxManager()->PrintStats(std::cout);
+        }
+        profiler->Print(std::cout);
+        std::cerr << "Error in iteration " << i << ": " << e.what() << std::endl;
+        if (recorder) {
+            recorder->getTrace(seed, i).Save(options.record_file);
+            std::cerr << "Schedule of iteration " << i << " written to " << options.record_file << std::endl;
+        }
+        if (tracer) {
+            tracer->Save(options.timeline_file);
+            std::cerr << "Timeline of iteration " << i << " written to " << options.timeline_file << std::endl;
+        }
+        return 1;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start_time;
+    if (recorder && run_iters > 0) {
+        recorder->getTrace(seed, run_iters - 1).Save(options.record_file);
+        std::cout << "Schedule of iteration " << run_iters - 1 << " written to " << options.record_file << std::endl;
+    }
+    if (tracer && run_iters > 0) {
+        tracer->Save(options.timeline_file);
+        std::cout << "Timeline of iteration " << run_iters - 1 << " written to " << options.timeline_file << std::endl;
+    }
+    if (options.wait_stats) {
+        comm_group->PrintWaitStats(std::cout);
+    }
+    if (options.mailbox_stats) {
+        comm_group->getMailboxManager()->PrintStats(std::cout);
+    }
+    PrintIterationRate(run_iters, elapsed, std::cout);
+    if (topology) {
+        comm_group->PrintNumaPlacement(*topology, std::cout);
+    }
+    profiler->Print(std::cout);
+    std::cout << "All tests passed." << std::endl;
+    return 0;
+}
+
+std::shared_ptr<CommGroup> LoadCommGroup(tinyxml2::XMLDocument& doc, const char* xml_file, CollectiveKind kind, PhaseProfiler& profiler) {
+    profiler.Begin("parse");
+    doc.LoadFile(xml_file);
+    profiler.End();
+    if (doc.Error()) {
+        std::cerr << "Error loading XML file: " << doc.ErrorIDToName(doc.ErrorID()) << std::endl;
+        return nullptr;
+    }
+    tinyxml2::XMLElement* root_elem = doc.RootElement();
+    std::shared_ptr<CommGroup> comm_group = std::make_shared<CommGroup>();
+    profiler.Begin("InitializeRanks");
+    comm_group->InitializeRanks(root_elem);
+    profiler.End();
+
+    const std::string coll = ExpectedCollAttribute(kind);
+    if (SafeGetAttribute(root_elem, "coll") != coll) {
+        std::cerr << "Error: Only " << CollectiveKindName(kind) << " collective is supported";
+        if (coll != CollectiveKindName(kind)) {
+            std::cerr << " (coll should be \"" << coll << "\" in the xml)";
+        }
+        std::cerr << "." << std::endl;
+        return nullptr;
+    }
+
+    const int num_ranks = static_cast<int>(comm_group->getNumRanks());
+    const int chunk_factor = static_cast<int>(comm_group->getChunkFactor());
+    const int num_chunks = static_cast<int>(comm_group->getNumChunks());
+    std::cout << "Initialized " << num_ranks << " ranks, " << num_chunks << " chunks, chunk factor " << chunk_factor << std::endl;
+
+    if (!comm_group->getMailboxManager()->checkNoPendingConnections()) {
+        std::cerr << "Error: There are pending connections in the mailbox manager." << std::endl
+                  << comm_group->getMailboxManager()->DescribePendingConnections();
+        return nullptr;
+    }
+    if (!comm_group->getMailboxManager()->checkChannelLayout()) {
+        std::cerr << "Error: Invalid channel layout in the mailbox manager." << std::endl;
+        return nullptr;
+    }
+    std::cout << "Channels built." << std::endl;
+    return comm_group;
+}
+
+int VerifierMain(int argc, char* argv[], CollectiveKind kind) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <input_xml_file> <run_iters> [options]" << std::endl << VerifierOptionsUsage();
+        return 1;
+    }
+    VerifierOptions options;
+    try {
+        options = ParseVerifierOptions(argc, argv, 3);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl << VerifierOptionsUsage();
+        return 1;
+    }
+    PhaseProfiler profiler(options.perf_counters);
+    tinyxml2::XMLDocument doc;
+    std::shared_ptr<CommGroup> comm_group = LoadCommGroup(doc, argv[1], kind, profiler);
+    if (!comm_group) {
+        return 1;
+    }
+
+    int run_iters = std::stoi(argv[2]);
+    return RunIterations(comm_group, MakeCollectiveSpec(kind, *comm_group), run_iters, options, &profiler);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "perf_counters.hpp"
+#include "threadblock.hpp"
+#include <string>
+
+enum class CollectiveKind; // Defined in collectives.hpp
+
+/**
+ * @brief Options shared by all verifiers, given as trailing --key=value arguments.
+ */
+struct VerifierOptions {
+    enum class Scheduler {
+        threads, // One CPU thread per threadblock, staggered by random sleeps
+        pct      // Serial probabilistic concurrency testing
+    };
+    Scheduler scheduler = Scheduler::threads;
+    int pct_depth = 3;
+    bool has_seed = false;
+    unsigned int seed = 0;
+    std::string record_file; // Schedule trace of the first failing (or the last) iteration
+    std::string replay_file; // Schedule trace to re-execute instead of running iterations
+    std::string minimize_file; // Minimized version of the replayed trace
+    std::string timeline_file; // Chrome trace of the first failing (or the last) iteration
+    bool provenance = false;
+    bool mailbox_stats = false; // Print the traffic of every mailbox at the end
+    bool wait_stats = false; // Print where the time of the threadblocks went at the end
+    bool perf_counters = false; // Report hardware counters per phase
+    size_t simulate_bytes = 0; // Buffer size of the timing simulation; 0 runs the verification
+    std::string sim_config_file; // Cost model of the timing simulation
+    std::string topology_file; // Physical links shared by the transfers of the timing simulation
+    bool critical_path = false; // Report the critical path and slack of the timing simulation
+    int num_processes = 1; // Worker processes, each running a contiguous group of ranks
+    int num_replicas = 1; // Independent CommGroups running iterations concurrently
+    enum class Numa {
+        off,
+        report, // Report the placement of buffers and mailboxes, and the iteration rate
+        place   // Pin every rank to a NUMA node and first-touch its memory there, then report
+    };
+    Numa numa = Numa::off;
+};
+
+/**
+ * @brief Describes the buffers of a collective.
+ */
+struct CollectiveSpec {
+    std::function<ChunkDataType(int, size_t)> init_func;
+    size_t input_buff_size;
+    std::function<ChunkDataType(int, size_t)> check_func;
+    size_t output_buff_size;
+};
+
+/**
+ * @brief Parses the options in argv[first_option, argc).
+ * Throws on unknown options or malformed values.
+ */
+VerifierOptions ParseVerifierOptions(int argc, char* argv[], int first_option);
+
+/**
+ * @brief Returns the help text of the options, one option per line.
+ */
+std::string VerifierOptionsUsage();
+
+/**
+ * @brief Runs the collective run_iters times, checking the output buffers after each run.
+ * @param profiler If not null, times every ExecuteRanks and CheckData, and is printed at the end.
+ * @return The exit code of the verifier.
+ */
+int RunIterations(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, int run_iters, const VerifierOptions& options,
+                  PhaseProfiler* profiler = nullptr);
+
+/**
+ * @brief Loads an XML into a new CommGroup and checks its collective, connections and channel
+ * layout, printing the same progress lines in every verifier.
+ * @param doc Holds the parsed XML, which must outlive the group (replicas are built from it).
+ * @return The group, or nullptr after printing the error.
+ */
+std::shared_ptr<CommGroup> LoadCommGroup(tinyxml2::XMLDocument& doc, const char* xml_file, CollectiveKind kind, PhaseProfiler& profiler);
+
+/**
+ * @brief The main function of a verifier taking <input_xml_file> <run_iters> [options].
+ * @return The exit code of the verifier.
+ */
+int VerifierMain(int argc, char* argv[], CollectiveKind kind);
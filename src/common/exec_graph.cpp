@@ -0,0 +1,181 @@
+#include "exec_graph.hpp"
+#include <sstream>
+
+ExecGraph::ExecGraph(std::shared_ptr<CommGroup> comm_group) {
+    const size_t num_ranks = comm_group->getNumRanks();
+    first_node.resize(num_ranks);
+    std::map<const Mailbox*, std::vector<int>> sent, received;
+    for (size_t r = 0; r < num_ranks; ++r) {
+        auto rank = comm_group->getRank(r);
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            auto tb = rank->getThreadBlock(t);
+            first_node[r].push_back(nodes.size());
+            const auto &insts = tb->getInstructions();
+            for (size_t s = 0; s < insts.size(); ++s) {
+                const Instruction &inst = insts[s];
+                int id = static_cast<int>(nodes.size());
+                nodes.push_back({static_cast<int>(r), static_cast<int>(t), static_cast<int>(s), inst.op, inst.num_chunks,
+                                 IsSendOp(inst.op) ? tb->getSendPeer() : -1, -1, -1, false});
+                if (IsSendOp(inst.op) && tb->getSendMailbox()) {
+                    sent[tb->getSendMailbox().get()].push_back(id);
+                }
+                if (IsRecvOp(inst.op) && tb->getRecvMailbox()) {
+                    received[tb->getRecvMailbox().get()].push_back(id);
+                }
+            }
+        }
+    }
+    for (const auto& [mailbox, sends] : sent) {
+        const auto &recvs = received[mailbox];
+        for (size_t k = 0; k < std::min(sends.size(), recvs.size()); ++k) {
+            nodes[sends[k]].matched_recv = recvs[k];
+            nodes[recvs[k]].matched_send = sends[k];
+        }
+    }
+
+    // At most three predecessors per node: program order, dependency and matched send
+    pred_offsets.reserve(nodes.size() + 1);
+    pred_offsets.push_back(0);
+    for (size_t r = 0; r < num_ranks; ++r) {
+        auto rank = comm_group->getRank(r);
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            const auto &insts = rank->getThreadBlock(t)->getInstructions();
+            for (size_t s = 0; s < insts.size(); ++s) {
+                size_t id = first_node[r][t] + s;
+                if (s > 0) {
+                    preds.push_back(static_cast<int>(id - 1));
+                }
+                const Instruction &inst = insts[s];
+                if (inst.dep_tbid >= 0 || inst.dep_step >= 0) {
+                    if (inst.dep_tbid >= 0 && inst.dep_step >= 0 && static_cast<size_t>(inst.dep_tbid) < rank->getNumThreadBlocks() &&
+                        static_cast<size_t>(inst.dep_step) < rank->getThreadBlock(inst.dep_tbid)->getInstructions().size() &&
+                        rank->getThreadBlock(inst.dep_tbid)->getInstructions()[inst.dep_step].has_dep) {
+                        preds.push_back(static_cast<int>(first_node[r][inst.dep_tbid] + inst.dep_step));
+                    } else {
+                        nodes[id].missing_dep = true;
+                    }
+                }
+                if (nodes[id].matched_send >= 0) {
+                    preds.push_back(nodes[id].matched_send);
+                }
+                pred_offsets.push_back(preds.size());
+            }
+        }
+    }
+
+    succ_offsets.assign(nodes.size() + 1, 0);
+    for (int p : preds) {
+        ++succ_offsets[p + 1];
+    }
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        succ_offsets[n + 1] += succ_offsets[n];
+    }
+    succs.resize(preds.size());
+    std::vector<size_t> fill(succ_offsets.begin(), succ_offsets.end() - 1);
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        for (const int *p = PredecessorsBegin(n); p != PredecessorsEnd(n); ++p) {
+            succs[fill[*p]++] = static_cast<int>(n);
+        }
+    }
+}
+
+size_t ExecGraph::getNumNodes() const {
+    return nodes.size();
+}
+
+size_t ExecGraph::getNumEdges() const {
+    return preds.size();
+}
+
+const ExecGraph::Node& ExecGraph::getNode(size_t node) const {
+    return nodes.at(node);
+}
+
+size_t ExecGraph::getNodeId(int rank_id, int tbid, int step) const {
+    return first_node.at(rank_id).at(tbid) + step;
+}
+
+size_t ExecGraph::getFirstNode(int rank_id, int tbid) const {
+    return first_node.at(rank_id).at(tbid);
+}
+
+size_t ExecGraph::getEndNode(int rank_id, int tbid) const {
+    if (static_cast<size_t>(tbid) + 1 < first_node.at(rank_id).size()) {
+        return first_node[rank_id][tbid + 1];
+    }
+    for (size_t r = rank_id + 1; r < first_node.size(); ++r) {
+        if (!first_node[r].empty()) {
+            return first_node[r].front();
+        }
+    }
+    return nodes.size();
+}
+
+size_t ExecGraph::getNumThreadBlocks(int rank_id) const {
+    return first_node.at(rank_id).size();
+}
+
+size_t ExecGraph::getNumRanks() const {
+    return first_node.size();
+}
+
+const int* ExecGraph::PredecessorsBegin(size_t node) const {
+    return preds.data() + pred_offsets[node];
+}
+
+const int* ExecGraph::PredecessorsEnd(size_t node) const {
+    return preds.data() + pred_offsets[node + 1];
+}
+
+const int* ExecGraph::SuccessorsBegin(size_t node) const {
+    return succs.data() + succ_offsets[node];
+}
+
+const int* ExecGraph::SuccessorsEnd(size_t node) const {
+    return succs.data() + succ_offsets[node + 1];
+}
+
+std::vector<int> ExecGraph::TopologicalOrder() const {
+    std::vector<int> pending(nodes.size());
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (IsRecvOp(nodes[n].op) && nodes[n].matched_send < 0) {
+            throw std::runtime_error("No step sends the message received by " + Describe(n) + ".");
+        }
+        if (nodes[n].missing_dep) {
+            throw std::runtime_error("The dependency of " + Describe(n) + " names a missing step or one without hasdep.");
+        }
+        pending[n] = static_cast<int>(pred_offsets[n + 1] - pred_offsets[n]);
+    }
+
+    // Kahn's algorithm, using the output as the queue
+    std::vector<int> order;
+    order.reserve(nodes.size());
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (pending[n] == 0) {
+            order.push_back(static_cast<int>(n));
+        }
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        int n = order[i];
+        for (const int *succ = SuccessorsBegin(n); succ != SuccessorsEnd(n); ++succ) {
+            if (--pending[*succ] == 0) {
+                order.push_back(*succ);
+            }
+        }
+    }
+    if (order.size() != nodes.size()) {
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            if (pending[n] > 0) {
+                throw std::runtime_error("Cyclic dependencies between steps, e.g. at " + Describe(n) + ".");
+            }
+        }
+    }
+    return order;
+}
+
+std::string ExecGraph::Describe(size_t node) const {
+    const Node &n = nodes.at(node);
+    std::ostringstream os;
+    os << "rank " << n.rank << " tb " << n.tbid << " step " << n.step << " (" << n.op << ")";
+    return os.str();
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "threadblock.hpp"
+
+/**
+ * @brief The static dependency graph of all steps of a CommGroup.
+ *
+ * Steps are numbered rank by rank, threadblock by threadblock. A step depends on the previous
+ * step of its threadblock, on the step named by its depid/deps attributes, and, if it receives,
+ * on the step that sent the message it consumes. Since every mailbox is a FIFO queue with a
+ * single sender and a single receiver, the k-th message sent into a mailbox is consumed by the
+ * k-th receiving step of its receiver, so this matching is known without running the XML.
+ */
+class ExecGraph {
+public:
+    struct Node {
+        int rank;
+        int tbid;
+        int step;
+        OpType op;
+        size_t num_chunks;
+        int send_peer;       // Peer rank of a sending step, -1 otherwise
+        int matched_send;    // Node that sent the message of a receiving step, -1 if none
+        int matched_recv;    // Node that receives the message of a sending step, -1 if none
+        bool missing_dep;    // The depid/deps step does not exist or does not set hasdep
+    };
+
+    explicit ExecGraph(std::shared_ptr<CommGroup> comm_group);
+
+    size_t getNumNodes() const;
+    size_t getNumEdges() const;
+    const Node& getNode(size_t node) const;
+    /**
+     * @brief Returns the node of a step.
+     */
+    size_t getNodeId(int rank_id, int tbid, int step) const;
+    /**
+     * @brief Returns the first node of a threadblock; its steps are consecutive nodes.
+     */
+    size_t getFirstNode(int rank_id, int tbid) const;
+    /**
+     * @brief Returns one past the last node of a threadblock.
+     */
+    size_t getEndNode(int rank_id, int tbid) const;
+    size_t getNumThreadBlocks(int rank_id) const;
+    size_t getNumRanks() const;
+    /**
+     * @brief Returns the nodes a node depends on, in [begin, end).
+     */
+    const int* PredecessorsBegin(size_t node) const;
+    const int* PredecessorsEnd(size_t node) const;
+    /**
+     * @brief Returns the nodes that depend on a node, in [begin, end).
+     */
+    const int* SuccessorsBegin(size_t node) const;
+    const int* SuccessorsEnd(size_t node) const;
+    /**
+     * @brief Returns all nodes in an order where each node follows its predecessors.
+     * Throws if a receiving step has no matching send or the dependencies are cyclic, as the
+     * XML then deadlocks under any schedule.
+     */
+    std::vector<int> TopologicalOrder() const;
+    /**
+     * @brief Formats a node as "rank r tb t step s (op)".
+     */
+    std::string Describe(size_t node) const;
+
+private:
+    std::vector<Node> nodes;
+    std::vector<std::vector<size_t>> first_node; // Per rank and threadblock
+    std::vector<size_t> pred_offsets; // Predecessors of node n are preds[pred_offsets[n], pred_offsets[n + 1])
+    std::vector<int> preds;
+    std::vector<size_t> succ_offsets; // Same layout for successors
+    std::vector<int> succs;
+};
@@ -12,6 +12,14 @@ static OpType opStrToOp(const char *op_str) {
         return OpType::nop;
     } else if (strcmp(op_str, "rcs") == 0) {
         return OpType::rcs;
+    } else if (strcmp(op_str, "re") == 0) {
+        return OpType::reduce;
+    } else if (strcmp(op_str, "rrc") == 0) {
+        return OpType::rrc;
+    } else if (strcmp(op_str, "rrs") == 0) {
+        return OpType::rrs;
+    } else if (strcmp(op_str, "rrcs") == 0) {
+        return OpType::rrcs;
     } else {
         throw std::runtime_error("Unknown operation " + std::string(op_str));
     }
@@ -41,9 +49,12 @@ Instruction::Instruction(tinyxml2::XMLElement* step_elem) {
     dep_step = std::stoi(SafeGetAttribute(step_elem, "deps"));
     has_dep = std::stoi(SafeGetAttribute(step_elem, "hasdep")) != 0;
 
-    if (op == OpType::rcs) {
+    // Forwarding operations send the chunks they received under the same location
+    if (op == OpType::rcs || op == OpType::rrs || op == OpType::rrcs) {
         if (src_buff != dst_buff || src_off != dst_off) {
-            throw std::runtime_error("For RCS operation, src and dst buffers and offsets must match.");
+            throw std::runtime_error(op == OpType::rcs ? "For RCS operation, src and dst buffers and offsets must match." :
+                                     op == OpType::rrs ? "For RRS operation, src and dst buffers and offsets must match." :
+                                                         "For RRCS operation, src and dst buffers and offsets must match.");
         }
     }
 
@@ -61,6 +72,10 @@ std::ostream& operator<<(std::ostream& os, const OpType& op) {
         case OpType::copy: os << "copy"; break;
         case OpType::nop: os << "nop"; break;
         case OpType::rcs: os << "rcs"; break;
+        case OpType::reduce: os << "reduce"; break;
+        case OpType::rrc: os << "rrc"; break;
+        case OpType::rrs: os << "rrs"; break;
+        case OpType::rrcs: os << "rrcs"; break;
     }
     return os;
 }
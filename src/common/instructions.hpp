@@ -8,7 +8,11 @@ enum class OpType {
     recv,
     copy,
     nop,
-    rcs
+    rcs,
+    reduce,
+    rrc,
+    rrs,
+    rrcs
 };
 
 enum class BufferType {
@@ -32,6 +36,27 @@ struct Instruction {
     Instruction(tinyxml2::XMLElement* step_elem);
 };
 
+/**
+ * @brief Returns true if the operation consumes a message from the receive mailbox.
+ */
+inline bool IsRecvOp(OpType op) {
+    return op == OpType::recv || op == OpType::rcs || op == OpType::rrc || op == OpType::rrs || op == OpType::rrcs;
+}
+
+/**
+ * @brief Returns true if the operation pushes a message to the send mailbox.
+ */
+inline bool IsSendOp(OpType op) {
+    return op == OpType::send || op == OpType::rcs || op == OpType::rrs || op == OpType::rrcs;
+}
+
+/**
+ * @brief Returns true if the operation reduces chunks instead of overwriting them.
+ */
+inline bool IsReduceOp(OpType op) {
+    return op == OpType::reduce || op == OpType::rrc || op == OpType::rrs || op == OpType::rrcs;
+}
+
 inline const char *SafeGetAttribute(tinyxml2::XMLElement* elem, const char* attr_name) {
     const char* value = elem->Attribute(attr_name);
     if (!value) {
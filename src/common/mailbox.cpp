@@ -1,18 +1,71 @@
 #include "mailbox.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
 #include <set>
+#include <sstream>
+#include <unistd.h>
+
+static int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 void Mailbox::sendMessage(const Message& msg) {
-    std::lock_guard<std::mutex> lock(mailboxMutex);
-    inbox.push(msg);
+    if (ring) {
+        EncodeMessage(msg, track_stats ? NowNs() : 0, send_record);
+        int tries = 0;
+        while (!ring->TryPush(send_record)) {
+            if (++tries == MAX_TRIES) {
+                throw std::runtime_error("Shared mailbox is full.");
+            }
+            std::this_thread::sleep_for(SLEEP_TIME);
+        }
+        if (track_stats) {
+            num_messages.fetch_add(1, std::memory_order_relaxed);
+            num_chunks.fetch_add(msg.chunks.size(), std::memory_order_relaxed);
+        }
+        return;
+    }
+    if (!track_stats) {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        inbox.push(msg);
+        return;
+    }
+    uint64_t depth;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        inbox.push(msg);
+        inbox.back().sent_ns = NowNs();
+        depth = inbox.size();
+    }
+    num_messages.fetch_add(1, std::memory_order_relaxed);
+    num_chunks.fetch_add(msg.chunks.size(), std::memory_order_relaxed);
+    // Only the sender raises the high-water mark
+    if (depth > high_water.load(std::memory_order_relaxed)) {
+        high_water.store(depth, std::memory_order_relaxed);
+    }
 }
 
 bool Mailbox::receiveMessage(Message& msg) {
     for (int tries = 0; tries < MAX_TRIES; ++tries) {
-        {
+        if (ring) {
+            if (ring->TryPop(recv_record)) {
+                DecodeMessage(recv_record, msg);
+                if (track_stats) {
+                    residency_ns.fetch_add(NowNs() - msg.sent_ns, std::memory_order_relaxed);
+                    num_received.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        } else {
             std::lock_guard<std::mutex> lock(mailboxMutex);
             if (!inbox.empty()) {
                 msg = inbox.front();
                 inbox.pop();
+                if (track_stats) {
+                    residency_ns.fetch_add(NowNs() - msg.sent_ns, std::memory_order_relaxed);
+                    num_received.fetch_add(1, std::memory_order_relaxed);
+                }
                 return true;
             }
         }
@@ -22,52 +75,146 @@ bool Mailbox::receiveMessage(Message& msg) {
 }
 
 bool Mailbox::isEmpty() const {
+    if (ring) {
+        return ring->Empty();
+    }
     std::lock_guard<std::mutex> lock(mailboxMutex);
     return inbox.empty();
 }
 
-bool MailboxManager::getSendMailbox(int send_rank, int recv_rank, int chan_id, std::shared_ptr<Mailbox>& mailbox) {
-    MapKey key{send_rank, recv_rank, chan_id};
-    std::lock_guard<std::mutex> lock(mailboxManagerMutex);
-    auto it = established_mailboxes.find(key);
-    if (it != established_mailboxes.end()) {
-        mailbox = it->second;
-        return false;
-    } else {
-        mailbox = std::make_shared<Mailbox>();
-        pending_mailboxes[key] = mailbox;
-        return true;
+void Mailbox::clear() {
+    if (ring) {
+        ring->Reset();
     }
+    std::lock_guard<std::mutex> lock(mailboxMutex);
+    inbox = std::queue<Message>();
 }
 
-bool MailboxManager::getRecvMailbox(int send_rank, int recv_rank, int chan_id, std::shared_ptr<Mailbox>& mailbox) {
-    MapKey key{send_rank, recv_rank, chan_id};
-    for (int tries = 0; tries < MAX_TRIES; ++tries) {
-        {
-            std::lock_guard<std::mutex> lock(mailboxManagerMutex);
-            auto it = pending_mailboxes.find(key);
-            if (it != pending_mailboxes.end()) {
-                mailbox = it->second;
-                established_mailboxes[key] = mailbox;
-                pending_mailboxes.erase(it);
-                return true;
-            }
+MailboxStats Mailbox::getStats() const {
+    uint64_t received = num_received.load(std::memory_order_relaxed);
+    return {num_messages.load(std::memory_order_relaxed), num_chunks.load(std::memory_order_relaxed), high_water.load(std::memory_order_relaxed),
+            received == 0 ? 0.0 : residency_ns.load(std::memory_order_relaxed) / 1e3 / received};
+}
+
+void Mailbox::ResetStats() {
+    num_messages.store(0, std::memory_order_relaxed);
+    num_chunks.store(0, std::memory_order_relaxed);
+    high_water.store(0, std::memory_order_relaxed);
+    num_received.store(0, std::memory_order_relaxed);
+    residency_ns.store(0, std::memory_order_relaxed);
+}
+
+void Mailbox::EnableStats(bool enable) {
+    track_stats = enable;
+}
+
+void Mailbox::AttachRing(SharedRing* shared_ring) {
+    ring = shared_ring;
+}
+
+bool Mailbox::isShared() const {
+    return ring != nullptr;
+}
+
+/**
+ * @brief Allocates an array of mailboxes on pages of its own, so that moving its pages to another
+ * NUMA node moves nothing else.
+ */
+static std::shared_ptr<Mailbox[]> AllocateMailboxes(size_t count) {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t bytes = std::max<size_t>((count * sizeof(Mailbox) + page_size - 1) / page_size * page_size, page_size);
+    void* memory = std::aligned_alloc(page_size, bytes);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    Mailbox* array = static_cast<Mailbox*>(memory);
+    for (size_t i = 0; i < count; ++i) {
+        new (&array[i]) Mailbox();
+    }
+    return std::shared_ptr<Mailbox[]>(array, [count](Mailbox* p) {
+        for (size_t i = 0; i < count; ++i) {
+            p[i].~Mailbox();
+        }
+        std::free(p);
+    });
+}
+
+static bool EndpointLess(const MailboxManager::Endpoint& a, const MailboxManager::Endpoint& b) {
+    return std::tie(a.key.send_rank, a.key.recv_rank, a.key.chan_id, a.tbid) < std::tie(b.key.send_rank, b.key.recv_rank, b.key.chan_id, b.tbid);
+}
+
+static bool SameKey(const MailboxManager::MapKey& a, const MailboxManager::MapKey& b) {
+    return a.send_rank == b.send_rank && a.recv_rank == b.recv_rank && a.chan_id == b.chan_id;
+}
+
+static void CheckUniqueEndpoints(const std::vector<MailboxManager::Endpoint>& endpoints, bool sending) {
+    for (size_t i = 1; i < endpoints.size(); ++i) {
+        const auto &prev = endpoints[i - 1], &cur = endpoints[i];
+        if (SameKey(prev.key, cur.key)) {
+            int rank = sending ? cur.key.send_rank : cur.key.recv_rank;
+            int peer = sending ? cur.key.recv_rank : cur.key.send_rank;
+            throw std::runtime_error("ThreadBlocks " + std::to_string(prev.tbid) + " and " + std::to_string(cur.tbid) + " in rank " + std::to_string(rank) +
+                                     (sending ? " both send to rank " : " both receive from rank ") + std::to_string(peer) + " in channel " +
+                                     std::to_string(cur.key.chan_id) + ".");
         }
-        std::this_thread::sleep_for(SLEEP_TIME);
     }
-    return false;
+}
+
+void MailboxManager::Connect(std::vector<Endpoint> sends, std::vector<Endpoint> recvs) {
+    std::sort(sends.begin(), sends.end(), EndpointLess);
+    std::sort(recvs.begin(), recvs.end(), EndpointLess);
+    CheckUniqueEndpoints(sends, true);
+    CheckUniqueEndpoints(recvs, false);
+
+    keys.clear();
+    pending_sends.clear();
+    pending_recvs.clear();
+    size_t i = 0, j = 0;
+    while (i < sends.size() || j < recvs.size()) {
+        if (j == recvs.size() || (i < sends.size() && sends[i].key < recvs[j].key)) {
+            pending_sends.push_back(sends[i++]);
+        } else if (i == sends.size() || recvs[j].key < sends[i].key) {
+            pending_recvs.push_back(recvs[j++]);
+        } else {
+            keys.push_back(sends[i].key); // The merge visits keys in order, so keys stays sorted
+            ++i;
+            ++j;
+        }
+    }
+    mailboxes = AllocateMailboxes(keys.size());
+}
+
+std::shared_ptr<Mailbox> MailboxManager::getMailbox(int send_rank, int recv_rank, int chan_id) const {
+    MapKey key{send_rank, recv_rank, chan_id};
+    auto it = std::lower_bound(keys.begin(), keys.end(), key);
+    if (it == keys.end() || key < *it) {
+        return nullptr;
+    }
+    // Aliasing constructor: points into the array and keeps the whole array alive
+    return std::shared_ptr<Mailbox>(mailboxes, &mailboxes[it - keys.begin()]);
 }
 
 bool MailboxManager::checkNoPendingConnections() const {
-    std::lock_guard<std::mutex> lock(mailboxManagerMutex);
-    return pending_mailboxes.empty();
+    return pending_sends.empty() && pending_recvs.empty();
+}
+
+std::string MailboxManager::DescribePendingConnections() const {
+    std::ostringstream os;
+    for (const auto& endpoint : pending_sends) {
+        os << "  ThreadBlock " << endpoint.tbid << " in rank " << endpoint.key.send_rank << " sends to rank " << endpoint.key.recv_rank << " in channel "
+           << endpoint.key.chan_id << ", but no threadblock there receives from rank " << endpoint.key.send_rank << " in that channel." << std::endl;
+    }
+    for (const auto& endpoint : pending_recvs) {
+        os << "  ThreadBlock " << endpoint.tbid << " in rank " << endpoint.key.recv_rank << " receives from rank " << endpoint.key.send_rank << " in channel "
+           << endpoint.key.chan_id << ", but no threadblock there sends to rank " << endpoint.key.recv_rank << " in that channel." << std::endl;
+    }
+    return os.str();
 }
 
 bool MailboxManager::checkChannelLayout() const {
     std::map<std::pair<int, int>, std::set<int>> chan_send; // (rank_id, chan_id) -> set of send peers
     std::map<std::pair<int, int>, std::set<int>> chan_recv; // (rank_id, chan_id) -> set of recv peers
-    std::lock_guard<std::mutex> lock(mailboxManagerMutex);
-    for (const auto& [key, mailbox]: established_mailboxes) {
+    for (const auto& key : keys) {
         chan_send[{key.send_rank, key.chan_id}].insert(key.recv_rank);
         chan_recv[{key.recv_rank, key.chan_id}].insert(key.send_rank);
     }
@@ -120,12 +267,77 @@ bool MailboxManager::checkChannelLayout() const {
     return true;
 }
 
-bool MailboxManager::checkNoPendingMessage() const {
-    std::lock_guard<std::mutex> lock(mailboxManagerMutex);
-    for (const auto& [key, mailbox] : established_mailboxes) {
-        if (!mailbox->isEmpty()) {
+bool MailboxManager::checkNoPendingMessage(bool include_shared) const {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if ((include_shared || !mailboxes[i].isShared()) && !mailboxes[i].isEmpty()) {
             return false; // Found a mailbox with pending messages
         }
     }
     return true;
-}
\ No newline at end of file
+}
+
+void MailboxManager::ClearMessages() {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        mailboxes[i].clear();
+    }
+}
+
+void MailboxManager::EnableStats(bool enable) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        mailboxes[i].EnableStats(enable);
+    }
+}
+
+void MailboxManager::ResetStats() {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        mailboxes[i].ResetStats();
+    }
+}
+
+size_t MailboxManager::PlaceMailboxes(const std::function<int(int)>& node_of_rank) {
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    size_t unmoved_pages = 0;
+    size_t i = 0;
+    while (i < keys.size()) {
+        // Mailboxes are small, so a page holds many; it goes where most of their receivers run
+        uintptr_t page = reinterpret_cast<uintptr_t>(&mailboxes[i]) / page_size;
+        std::map<int, int> votes;
+        for (; i < keys.size() && reinterpret_cast<uintptr_t>(&mailboxes[i]) / page_size == page; ++i) {
+            votes[node_of_rank(keys[i].recv_rank)]++;
+        }
+        auto best = std::max_element(votes.begin(), votes.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        if (!MoveNumaPages(reinterpret_cast<void*>(page * page_size), page_size, best->first)) {
+            ++unmoved_pages;
+        }
+    }
+    return unmoved_pages;
+}
+
+NumaPageCounts MailboxManager::CountMailboxPages(const std::function<int(int)>& node_of_rank) const {
+    NumaPageCounts counts;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        counts += CountNumaPages(&mailboxes[i], 1, node_of_rank(keys[i].recv_rank));
+    }
+    return counts;
+}
+
+void MailboxManager::PrintStats(std::ostream& os) const {
+    std::vector<std::pair<MapKey, MailboxStats>> stats;
+    uint64_t total_chunks = 0, max_high_water = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        stats.push_back({keys[i], mailboxes[i].getStats()});
+        total_chunks += stats.back().second.chunks;
+        max_high_water = std::max(max_high_water, stats.back().second.high_water);
+    }
+    double mean_chunks = stats.empty() ? 0.0 : static_cast<double>(total_chunks) / stats.size();
+    os << "Mailbox statistics (* = over twice the mean chunks, ^ = deepest queue):" << std::endl;
+    os << "  Send  Recv  Chan    Messages      Chunks  HighWater  MeanResidency(us)" << std::endl;
+    os << std::fixed << std::setprecision(3);
+    for (const auto& [key, st] : stats) {
+        os << std::setw(6) << key.send_rank << std::setw(6) << key.recv_rank << std::setw(6) << key.chan_id
+           << std::setw(12) << st.messages << std::setw(12) << st.chunks << std::setw(11) << st.high_water
+           << std::setw(19) << st.mean_residency_us
+           << (st.chunks > 2 * mean_chunks ? " *" : "") << (st.high_water == max_high_water && max_high_water > 1 ? " ^" : "") << std::endl;
+    }
+    os << std::defaultfloat;
+}
@@ -1,5 +1,10 @@
 #pragma once
+#include "chunk.hpp"
 #include "instructions.hpp"
+#include "provenance.hpp"
+#include "numa.hpp"
+#include "shm_transport.hpp"
+#include <atomic>
 #include <vector>
 #include <thread>
 #include <chrono>
@@ -7,21 +12,38 @@
 #include <mutex>
 #include <memory>
 #include <map>
+#include <functional>
 
 #define MAX_TRIES 100000 // Total wait time: 100000 * 1us = 100ms
 #define SLEEP_TIME std::chrono::microseconds(1)
 
-using ChunkDataType = std::string;
-
 struct Message {
     std::vector<ChunkDataType> chunks;
     BufferType src_buff;
     std::ptrdiff_t src_off;
     BufferType dst_buff;
     std::ptrdiff_t dst_off;
+    std::vector<ChunkProvenance> provenance; // Parallel to chunks; empty unless provenance is tracked
+    int64_t sent_ns = 0; // Set by Mailbox::sendMessage if its statistics are enabled
+};
+
+/**
+ * @brief Traffic of a mailbox since its creation or the last ResetStats.
+ */
+struct MailboxStats {
+    uint64_t messages;
+    uint64_t chunks;
+    uint64_t high_water; // Most messages queued at once
+    double mean_residency_us; // Mean time from sending to receiving a message
 };
 
-class Mailbox {
+/**
+ * @brief A FIFO channel from one rank to another.
+ *
+ * Aligned to a cache line, so that mailboxes stored next to each other by MailboxManager do not
+ * share a line between the threadblocks using them.
+ */
+class alignas(64) Mailbox {
 public:
     /**
      * @brief Sends a message to the mailbox.
@@ -37,10 +59,38 @@ public:
      * @brief Checks if the mailbox is empty.
      */
     bool isEmpty() const;
+    /**
+     * @brief Drops all pending messages.
+     */
+    void clear();
+    MailboxStats getStats() const;
+    void ResetStats();
+    /**
+     * @brief Counts the traffic for getStats. Off by default, so messages do not pay for it.
+     * Must not be called while threadblocks run.
+     */
+    void EnableStats(bool enable);
+    /**
+     * @brief Passes messages through a ring in shared memory instead of the inbox, e.g. when the
+     * sender and the receiver run in different processes. The ring must outlive the mailbox's use.
+     */
+    void AttachRing(SharedRing* shared_ring);
+    bool isShared() const;
 
 private:
     std::queue<Message> inbox;
+    SharedRing* ring = nullptr;
+    bool track_stats = false;
+    // Records of the shared ring, reused for every message; each is only used by one side's thread
+    std::vector<uint64_t> send_record;
+    std::vector<uint64_t> recv_record;
     mutable std::mutex mailboxMutex; // Protect inbox
+    // Statistics are only counters, so relaxed atomics suffice and readers never take the lock
+    std::atomic<uint64_t> num_messages{0};
+    std::atomic<uint64_t> num_chunks{0};
+    std::atomic<uint64_t> high_water{0};
+    std::atomic<uint64_t> num_received{0};
+    std::atomic<int64_t> residency_ns{0};
 };
 
 class MailboxManager {
@@ -54,21 +104,36 @@ public:
         }
     };
     /**
-     * Get the send mailbox for a given source and destination rank and a channel.
-     * @return true if the mailbox is newly created, false if it already exists.
+     * @brief One side of a channel: a threadblock of send_rank sending, or of recv_rank receiving.
      */
-    bool getSendMailbox(int send_rank, int recv_rank, int chan_id, std::shared_ptr<Mailbox>& mailbox);
+    struct Endpoint {
+        MapKey key;
+        int tbid;
+    };
     /**
-     * Get the receive mailbox for a given source and destination rank and a channel.
-     * @return true if the mailbox was created, false if it was not found after maxTries attempts.
-     * The function will block for 1 ms between attempts.
+     * @brief Establishes a mailbox for every send endpoint with a receive endpoint of the same key.
+     *
+     * Endpoints are sorted and matched in a single merge, so the result does not depend on the
+     * order in which threadblocks were loaded. Unmatched endpoints are kept as pending connections.
+     * Throws if two threadblocks of a rank send (or receive) with the same peer and channel.
+     * Called once, before any threadblock runs; the mailboxes are fixed afterwards.
+     */
+    void Connect(std::vector<Endpoint> sends, std::vector<Endpoint> recvs);
+    /**
+     * @brief Returns the established mailbox of a channel, or nullptr if there is none.
+     *
+     * The mailbox shares ownership of the whole table, so it outlives the manager if needed.
      */
-    bool getRecvMailbox(int send_rank, int recv_rank, int chan_id, std::shared_ptr<Mailbox>& mailbox);
+    std::shared_ptr<Mailbox> getMailbox(int send_rank, int recv_rank, int chan_id) const;
 
     /**
      * @brief Checks if there is no pending connections.
      */
     bool checkNoPendingConnections() const;
+    /**
+     * @brief Describes every pending connection, one per line.
+     */
+    std::string DescribePendingConnections() const;
     /**
      * @brief Checks if the channel is valid.
      *
@@ -78,11 +143,42 @@ public:
 
     /**
      * @brief Checks if there is no pending message in any mailbox.
+     * @param include_shared Whether to check mailboxes attached to shared rings, which other processes may still drain.
+     */
+    bool checkNoPendingMessage(bool include_shared = true) const;
+
+    /**
+     * @brief Drops the pending messages of all mailboxes, e.g. after a failed run.
+     */
+    void ClearMessages();
+    /**
+     * @brief Enables or disables the statistics of every mailbox, before threadblocks run.
+     */
+    void EnableStats(bool enable);
+    /**
+     * @brief Restarts the statistics of every mailbox, e.g. between the traffic matrices of a sweep.
+     */
+    void ResetStats();
+    /**
+     * @brief Moves every page of the mailboxes to the NUMA node of most receivers on it.
+     * @return The number of pages the kernel refused to move.
+     */
+    size_t PlaceMailboxes(const std::function<int(int)>& node_of_rank);
+    /**
+     * @brief Counts the mailboxes on the NUMA node of their receiver and elsewhere.
+     */
+    NumaPageCounts CountMailboxPages(const std::function<int(int)>& node_of_rank) const;
+    /**
+     * @brief Prints the statistics of every established mailbox, marking those that carry more
+     * than twice the mean number of chunks or whose queue grew deepest.
      */
-    bool checkNoPendingMessage() const;
+    void PrintStats(std::ostream& os) const;
 
 private:
-    std::map<MapKey, std::shared_ptr<Mailbox>> established_mailboxes;
-    std::map<MapKey, std::shared_ptr<Mailbox>> pending_mailboxes;
-    mutable std::mutex mailboxManagerMutex; // Protect mailboxes
+    // Established channels in one contiguous array, sorted by key; keys[i] is the key of mailboxes[i].
+    // Both are only written by Connect, so the checks below sweep them without a lock.
+    std::vector<MapKey> keys;
+    std::shared_ptr<Mailbox[]> mailboxes; // Page-aligned, so PlaceMailboxes moves only mailboxes
+    std::vector<Endpoint> pending_sends; // Send endpoints without a receiver
+    std::vector<Endpoint> pending_recvs; // Receive endpoints without a sender
 };
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "minimizer.hpp"
+#include "exec_graph.hpp"
+#include "scheduler.hpp"
+#include <atomic>
+#include <numeric>
+
+/**
+ * @brief Union-find over step indices.
+ */
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t size): parent(size) {
+        std::iota(parent.begin(), parent.end(), 0);
+    }
+    size_t Find(size_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+    void Union(size_t x, size_t y) {
+        parent[Find(x)] = Find(y);
+    }
+
+private:
+    std::vector<size_t> parent;
+};
+
+ScheduleMinimizer::ScheduleMinimizer(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, size_t num_workers):
+    comm_group(comm_group), spec(spec) {
+    num_workers = std::max<size_t>(num_workers, 1);
+    for (size_t i = 0; i < num_workers; ++i) {
+        replicas.push_back(comm_group->CreateReplica());
+    }
+}
+
+size_t ScheduleMinimizer::ComputeUnits(const ScheduleTrace& trace, std::vector<int>& entry_unit) const {
+    ExecGraph graph(comm_group);
+    DisjointSets sets(graph.getNumNodes());
+    for (size_t n = 0; n < graph.getNumNodes(); ++n) {
+        if (graph.getNode(n).matched_recv >= 0) {
+            sets.Union(n, graph.getNode(n).matched_recv);
+        }
+    }
+
+    // Number the components of the steps in the trace
+    std::vector<std::vector<int>> next_step(comm_group->getNumRanks());
+    for (size_t r = 0; r < comm_group->getNumRanks(); ++r) {
+        next_step[r].assign(graph.getNumThreadBlocks(r), 0);
+    }
+    std::map<size_t, int> component_unit;
+    entry_unit.assign(trace.entries.size(), -1);
+    for (size_t i = 0; i < trace.entries.size(); ++i) {
+        int rank_id = trace.entries[i].rank;
+        int tbid = trace.entries[i].tbid & ~ScheduleTrace::SKIP_FLAG;
+        size_t step = graph.getNodeId(rank_id, tbid, next_step.at(rank_id).at(tbid)++);
+        if (trace.entries[i].tbid & ScheduleTrace::SKIP_FLAG) {
+            continue;
+        }
+        auto it = component_unit.emplace(sets.Find(step), static_cast<int>(component_unit.size())).first;
+        entry_unit[i] = it->second;
+    }
+    return component_unit.size();
+}
+
+std::string ScheduleMinimizer::Replay(size_t worker, const ScheduleTrace& trace) const {
+    auto replica = replicas.at(worker);
+    replica->getMailboxManager()->ClearMessages();
+    try {
+        replica->InitData(spec.init_func, spec.input_buff_size);
+        ReplaySchedule(replica, trace);
+        if (mismatch) {
+            // Only the chunk being minimized matters; other chunks may go wrong once steps are skipped
+            const auto &output = replica->getRank(mismatch->rank)->getBuffer(BufferType::output);
+            return (output.at(mismatch->index) == mismatch->actual) ? failure : "";
+        }
+        replica->CheckData(spec.check_func, spec.output_buff_size);
+        if (!replica->getMailboxManager()->checkNoPendingMessage()) {
+            return "There are pending messages in the mailbox after the replay.";
+        }
+    } catch (const DataMismatchError& e) {
+        if (!mismatch) {
+            return e.what();
+        }
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+std::vector<bool> ScheduleMinimizer::ReplayAll(const std::vector<ScheduleTrace>& traces) const {
+    std::vector<char> results(traces.size());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < std::min(replicas.size(), traces.size()); ++w) {
+        threads.emplace_back([this, w, &traces, &results, &next]() {
+            for (size_t i = next++; i < traces.size(); i = next++) {
+                results[i] = (Replay(w, traces[i]) == failure);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    return std::vector<bool>(results.begin(), results.end());
+}
+
+ScheduleTrace ScheduleMinimizer::Minimize(const ScheduleTrace& trace, std::ostream& log) {
+    failure.clear();
+    mismatch.reset();
+    auto replica = replicas.front();
+    replica->getMailboxManager()->ClearMessages();
+    try {
+        replica->InitData(spec.init_func, spec.input_buff_size);
+        ReplaySchedule(replica, trace);
+        replica->CheckData(spec.check_func, spec.output_buff_size);
+        if (!replica->getMailboxManager()->checkNoPendingMessage()) {
+            failure = "There are pending messages in the mailbox after the replay.";
+        }
+    } catch (const DataMismatchError& e) {
+        failure = e.what();
+        mismatch = std::make_unique<DataMismatchError>(e);
+    } catch (const std::exception& e) {
+        failure = e.what();
+    }
+    if (failure.empty()) {
+        throw std::runtime_error("Replaying the schedule trace does not fail; there is nothing to minimize.");
+    }
+    log << "Minimizing failure: " << failure << std::endl;
+
+    std::vector<int> entry_unit;
+    size_t num_units = ComputeUnits(trace, entry_unit);
+    auto make_trace = [&](const std::vector<size_t>& units) {
+        std::vector<bool> kept(num_units, false);
+        for (size_t u : units) {
+            kept[u] = true;
+        }
+        ScheduleTrace candidate = trace;
+        for (size_t i = 0; i < candidate.entries.size(); ++i) {
+            if (entry_unit[i] >= 0 && !kept[entry_unit[i]]) {
+                candidate.entries[i].tbid |= ScheduleTrace::SKIP_FLAG;
+            }
+        }
+        return candidate;
+    };
+
+    std::vector<size_t> current(num_units);
+    std::iota(current.begin(), current.end(), 0);
+    if (ReplayAll({make_trace({})}).front()) {
+        log << "  The failure reproduces with all recorded steps skipped" << std::endl;
+        current.clear();
+    }
+    size_t granularity = 2;
+    while (current.size() >= 2) {
+        log << "  " << current.size() << " units left, granularity " << granularity << std::endl;
+        // Split into chunks; candidates are all chunks followed by all complements
+        std::vector<std::vector<size_t>> chunks(granularity), candidates;
+        for (size_t i = 0; i < current.size(); ++i) {
+            chunks[i * granularity / current.size()].push_back(current[i]);
+        }
+        candidates = chunks;
+        if (granularity > 2) {
+            for (size_t c = 0; c < granularity; ++c) {
+                std::vector<size_t> complement;
+                for (size_t d = 0; d < granularity; ++d) {
+                    if (d != c) {
+                        complement.insert(complement.end(), chunks[d].begin(), chunks[d].end());
+                    }
+                }
+                candidates.push_back(complement);
+            }
+        }
+        std::vector<ScheduleTrace> traces;
+        for (const auto &candidate : candidates) {
+            traces.push_back(make_trace(candidate));
+        }
+        std::vector<bool> results = ReplayAll(traces);
+
+        auto reproduced = std::find(results.begin(), results.end(), true);
+        if (reproduced != results.end()) {
+            size_t c = reproduced - results.begin();
+            current = candidates[c];
+            granularity = (c < granularity) ? 2 : std::max<size_t>(granularity - 1, 2);
+        } else if (granularity >= current.size()) {
+            break;
+        } else {
+            granularity = std::min(granularity * 2, current.size());
+        }
+    }
+
+    ScheduleTrace minimized = make_trace(current);
+    std::map<std::pair<int, int>, std::vector<int>> kept_steps; // (rank, tbid) -> steps
+    std::map<std::pair<int, int>, int> next_step;
+    for (const auto &entry : minimized.entries) {
+        int tbid = entry.tbid & ~ScheduleTrace::SKIP_FLAG;
+        int step = next_step[{entry.rank, tbid}]++;
+        if (!(entry.tbid & ScheduleTrace::SKIP_FLAG)) {
+            kept_steps[{entry.rank, tbid}].push_back(step);
+        }
+    }
+    size_t num_kept = 0;
+    for (const auto& [key, steps] : kept_steps) {
+        num_kept += steps.size();
+    }
+    log << "Minimized to " << num_kept << " of " << trace.entries.size() << " recorded steps in " << kept_steps.size() << " threadblocks:" << std::endl;
+    for (const auto& [key, steps] : kept_steps) {
+        log << "  Rank " << key.first << " ThreadBlock " << key.second << ": steps";
+        for (int step : steps) {
+            log << " " << step;
+        }
+        log << std::endl;
+    }
+    return minimized;
+}
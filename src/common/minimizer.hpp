@@ -0,0 +1,45 @@
+#pragma once
+#include "driver.hpp"
+
+/**
+ * @brief Shrinks a failing schedule trace by delta debugging.
+ *
+ * The steps of a trace are grouped into units, such that a sending step and the receiving step
+ * that consumes its message always belong to the same unit. Delta debugging (ddmin) then looks
+ * for a minimal set of units such that replaying the trace with the steps of all other units
+ * skipped still fails the same way: a data mismatch is reproduced if the same output chunk
+ * still holds the same wrong value, any other error if it occurs with the same message.
+ * Candidate replays run in parallel, each worker on its own replica of the CommGroup.
+ */
+class ScheduleMinimizer {
+public:
+    ScheduleMinimizer(std::shared_ptr<CommGroup> comm_group, const CollectiveSpec& spec, size_t num_workers);
+    /**
+     * @brief Returns the minimized trace, logging the progress.
+     * Throws if replaying the trace does not fail.
+     */
+    ScheduleTrace Minimize(const ScheduleTrace& trace, std::ostream& log);
+
+private:
+    /**
+     * @brief Assigns each entry of the trace to a unit, or -1 if the entry is already skipped.
+     * @return The number of units.
+     */
+    size_t ComputeUnits(const ScheduleTrace& trace, std::vector<int>& entry_unit) const;
+    /**
+     * @brief Replays a trace on the replica of a worker.
+     * @return The error of the replay, or an empty string if it passed.
+     */
+    std::string Replay(size_t worker, const ScheduleTrace& trace) const;
+    /**
+     * @brief Replays traces in parallel.
+     * @return For each trace, whether it reproduces the failure being minimized.
+     */
+    std::vector<bool> ReplayAll(const std::vector<ScheduleTrace>& traces) const;
+
+    std::shared_ptr<CommGroup> comm_group;
+    CollectiveSpec spec;
+    std::vector<std::shared_ptr<CommGroup>> replicas;
+    std::string failure; // Error of the trace being minimized
+    std::unique_ptr<DataMismatchError> mismatch; // Set if the failure is a data mismatch
+};
@@ -0,0 +1,151 @@
+#include "numa.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+NumaPageCounts& NumaPageCounts::operator+=(const NumaPageCounts& other) {
+    local += other.local;
+    remote += other.remote;
+    unplaced += other.unplaced;
+    return *this;
+}
+
+double NumaPageCounts::RemoteRatio() const {
+    return local + remote == 0 ? 0.0 : static_cast<double>(remote) / (local + remote);
+}
+
+/**
+ * @brief Parses a kernel CPU list such as 0-3,8-11.
+ */
+static std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> result;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            result.push_back(cpu);
+        }
+    }
+    return result;
+}
+
+NumaTopology NumaTopology::Detect() {
+    NumaTopology topology;
+    const std::string root = "/sys/devices/system/node";
+    if (DIR *dir = opendir(root.c_str())) {
+        while (struct dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            std::ifstream cpulist(root + "/" + name + "/cpulist");
+            std::string list;
+            std::getline(cpulist, list);
+            std::vector<int> node_cpus = ParseCpuList(list);
+            if (!node_cpus.empty()) {
+                topology.cpus[std::stoi(name.substr(4))] = node_cpus; // Memory-only nodes run no threads
+            }
+        }
+        closedir(dir);
+    }
+    if (topology.cpus.empty()) {
+        auto &all = topology.cpus[0];
+        for (unsigned int cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+            all.push_back(static_cast<int>(cpu));
+        }
+    }
+    return topology;
+}
+
+int NumaTopology::getNumNodes() const {
+    return static_cast<int>(cpus.size());
+}
+
+int NumaTopology::NodeOfRank(int rank, int num_ranks) const {
+    auto it = cpus.begin();
+    std::advance(it, static_cast<int64_t>(rank) * getNumNodes() / num_ranks);
+    return it->first;
+}
+
+void NumaTopology::PinThread(int node) const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus.at(node)) {
+        CPU_SET(cpu, &set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        throw std::runtime_error("Cannot pin a thread to NUMA node " + std::to_string(node) + ": " + strerror(err));
+    }
+}
+
+std::string NumaTopology::ToString() const {
+    std::ostringstream os;
+    os << cpus.size() << " NUMA node" << (cpus.size() == 1 ? "" : "s") << " (";
+    for (auto it = cpus.begin(); it != cpus.end(); ++it) {
+        os << (it == cpus.begin() ? "" : ", ") << "node " << it->first << ": " << it->second.size() << " CPUs";
+    }
+    os << ")";
+    return os.str();
+}
+
+/**
+ * @brief Calls move_pages on every page of [begin, begin + bytes), querying their nodes if nodes is null.
+ */
+static bool MovePages(const void* begin, size_t bytes, const int* node, std::vector<int>& status) {
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first = reinterpret_cast<uintptr_t>(begin) / page_size * page_size;
+    uintptr_t end = reinterpret_cast<uintptr_t>(begin) + bytes;
+    std::vector<void*> pages;
+    for (uintptr_t page = first; page < end; page += page_size) {
+        pages.push_back(reinterpret_cast<void*>(page));
+    }
+    status.assign(pages.size(), 0);
+    std::vector<int> nodes(node ? pages.size() : 0, node ? *node : 0);
+    if (pages.empty()) {
+        return true;
+    }
+    return syscall(SYS_move_pages, 0, pages.size(), pages.data(), node ? nodes.data() : nullptr, status.data(), 0) >= 0;
+}
+
+NumaPageCounts CountNumaPages(const void* begin, size_t bytes, int local_node) {
+    NumaPageCounts counts;
+    std::vector<int> status;
+    if (bytes == 0) {
+        return counts;
+    }
+    if (!MovePages(begin, bytes, nullptr, status)) {
+        counts.unplaced = status.size();
+        return counts;
+    }
+    for (int node : status) {
+        if (node < 0) {
+            counts.unplaced++;
+        } else if (node == local_node) {
+            counts.local++;
+        } else {
+            counts.remote++;
+        }
+    }
+    return counts;
+}
+
+bool MoveNumaPages(const void* begin, size_t bytes, int node) {
+    std::vector<int> status;
+    return bytes == 0 || MovePages(begin, bytes, &node, status);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Pages of some memory on the node it belongs to, on other nodes, or not yet placed.
+ */
+struct NumaPageCounts {
+    size_t local = 0;
+    size_t remote = 0;
+    size_t unplaced = 0; // Never touched, or the kernel could not tell
+
+    NumaPageCounts& operator+=(const NumaPageCounts& other);
+    /**
+     * @brief Returns the fraction of placed pages that are remote, or 0 if none is placed.
+     */
+    double RemoteRatio() const;
+};
+
+/**
+ * @brief The NUMA nodes of the machine and their CPUs, read from /sys/devices/system/node.
+ *
+ * Without that directory (e.g. a kernel without NUMA support), all CPUs form a single node 0.
+ */
+class NumaTopology {
+public:
+    static NumaTopology Detect();
+
+    int getNumNodes() const;
+    /**
+     * @brief Spreads ranks over the nodes in contiguous blocks, so neighbouring ranks share a node.
+     * @return The kernel id of the node, as used by the functions below.
+     */
+    int NodeOfRank(int rank, int num_ranks) const;
+    /**
+     * @brief Restricts the calling thread, and the threads it creates afterwards, to the CPUs of a node.
+     */
+    void PinThread(int node) const;
+    std::string ToString() const;
+
+private:
+    std::map<int, std::vector<int>> cpus; // Node id -> CPUs; node ids may have gaps
+};
+
+/**
+ * @brief Counts the pages of [begin, begin + bytes) by the node they reside on, with move_pages.
+ */
+NumaPageCounts CountNumaPages(const void* begin, size_t bytes, int local_node);
+/**
+ * @brief Migrates the pages of [begin, begin + bytes) to a node. Returns false if the kernel refused.
+ */
+bool MoveNumaPages(const void* begin, size_t bytes, int node);
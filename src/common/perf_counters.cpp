@@ -0,0 +1,148 @@
+#include "perf_counters.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int OpenCounter(uint32_t type, uint64_t config, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.inherit = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() {
+    static const struct {
+        uint32_t type;
+        uint64_t config;
+        const char *name;
+    } events[num_counters] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, "cache references"},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache misses"},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context switches"},
+    };
+    for (int i = 0; i < num_counters; ++i) {
+        // Context switches happen in the kernel; hardware events are limited to user space, which
+        // perf_event_paranoid <= 2 allows without privileges
+        fds[i] = OpenCounter(events[i].type, events[i].config, events[i].type == PERF_TYPE_HARDWARE);
+        if (fds[i] < 0 && events[i].type != PERF_TYPE_HARDWARE) {
+            fds[i] = OpenCounter(events[i].type, events[i].config, true);
+        }
+        if (fds[i] < 0 && error.empty()) {
+            error = std::string("Cannot count ") + events[i].name + ": " + strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool PerfCounters::IsAvailable(Counter counter) const {
+    return fds[counter] >= 0;
+}
+
+const std::string& PerfCounters::getError() const {
+    return error;
+}
+
+PerfCounters::Counts PerfCounters::Read() const {
+    Counts counts{};
+    for (int i = 0; i < num_counters; ++i) {
+        uint64_t values[3]; // value, time enabled, time running
+        if (fds[i] < 0 || read(fds[i], values, sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        counts[i] = values[2] > 0 && values[2] < values[1] ? static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2]) : values[0];
+    }
+    return counts;
+}
+
+PhaseProfiler::PhaseProfiler(bool enable) {
+    if (enable) {
+        counters = std::make_unique<PerfCounters>();
+    }
+}
+
+void PhaseProfiler::Begin(const std::string& phase) {
+    if (!counters) {
+        return;
+    }
+    current = -1;
+    for (size_t i = 0; i < phases.size(); ++i) {
+        if (phases[i].name == phase) {
+            current = static_cast<int>(i);
+        }
+    }
+    if (current < 0) {
+        phases.push_back({phase});
+        current = static_cast<int>(phases.size()) - 1;
+    }
+    begin_counts = counters->Read();
+    begin_time = std::chrono::steady_clock::now();
+}
+
+void PhaseProfiler::End() {
+    if (!counters || current < 0) {
+        return;
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    PerfCounters::Counts end_counts = counters->Read();
+    Phase &phase = phases[current];
+    phase.runs++;
+    phase.wall_ms += std::chrono::duration<double, std::milli>(end_time - begin_time).count();
+    for (int i = 0; i < PerfCounters::num_counters; ++i) {
+        phase.counts[i] += end_counts[i] - begin_counts[i];
+    }
+    current = -1;
+}
+
+void PhaseProfiler::Print(std::ostream& os) const {
+    if (!counters) {
+        return;
+    }
+    if (!counters->getError().empty()) {
+        os << "Note: " << counters->getError() << " (no PMU, e.g. in a VM, or restricted by /proc/sys/kernel/perf_event_paranoid); such counters are shown as n/a." << std::endl;
+    }
+    auto count = [this](const Phase& phase, PerfCounters::Counter counter) {
+        return counters->IsAvailable(counter) ? std::to_string(phase.counts[counter]) : std::string("n/a");
+    };
+    os << "Performance counters per phase:" << std::endl;
+    os << std::left << std::setw(18) << "  Phase" << std::right << std::setw(6) << "Runs" << std::setw(12) << "Wall(ms)" << std::setw(16) << "Cycles"
+       << std::setw(16) << "Instructions" << std::setw(7) << "IPC" << std::setw(14) << "CacheMisses" << std::setw(8) << "Miss%" << std::setw(10) << "CtxSw" << std::endl;
+    for (const auto& phase : phases) {
+        std::ostringstream ipc, miss_rate;
+        ipc << std::fixed << std::setprecision(2);
+        miss_rate << std::fixed << std::setprecision(1);
+        if (counters->IsAvailable(PerfCounters::cycles) && counters->IsAvailable(PerfCounters::instructions) && phase.counts[PerfCounters::cycles] > 0) {
+            ipc << static_cast<double>(phase.counts[PerfCounters::instructions]) / phase.counts[PerfCounters::cycles];
+        } else {
+            ipc << "n/a";
+        }
+        if (counters->IsAvailable(PerfCounters::cache_references) && counters->IsAvailable(PerfCounters::cache_misses) &&
+            phase.counts[PerfCounters::cache_references] > 0) {
+            miss_rate << 100.0 * phase.counts[PerfCounters::cache_misses] / phase.counts[PerfCounters::cache_references];
+        } else {
+            miss_rate << "n/a";
+        }
+        os << "  " << std::left << std::setw(16) << phase.name << std::right << std::setw(6) << phase.runs << std::fixed << std::setprecision(3)
+           << std::setw(12) << phase.wall_ms << std::defaultfloat << std::setw(16) << count(phase, PerfCounters::cycles)
+           << std::setw(16) << count(phase, PerfCounters::instructions) << std::setw(7) << ipc.str() << std::setw(14) << count(phase, PerfCounters::cache_misses)
+           << std::setw(8) << miss_rate.str() << std::setw(10) << count(phase, PerfCounters::context_switches) << std::endl;
+    }
+}
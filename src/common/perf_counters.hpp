@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Hardware and software counters of the process, read with perf_event_open.
+ *
+ * Counters are opened with inherit, so the threads of threadblocks are counted, once they have
+ * been joined. Counters the kernel refuses (no PMU in a VM, perf_event_paranoid, seccomp) are
+ * reported as unavailable instead of failing.
+ */
+class PerfCounters {
+public:
+    enum Counter {
+        cycles,
+        instructions,
+        cache_references,
+        cache_misses,
+        context_switches,
+        num_counters
+    };
+    using Counts = std::array<uint64_t, num_counters>;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool IsAvailable(Counter counter) const;
+    /**
+     * @brief Returns why a counter could not be opened, or an empty string if all were.
+     */
+    const std::string& getError() const;
+    /**
+     * @brief Reads the counts since the counters were opened, scaled up if the kernel multiplexed them.
+     */
+    Counts Read() const;
+
+private:
+    std::array<int, num_counters> fds;
+    std::string error;
+};
+
+/**
+ * @brief Accumulates counters and wall time per named phase, e.g. parsing the XML or each ExecuteRanks.
+ *
+ * A disabled profiler opens no counters, and Begin and End do nothing.
+ */
+class PhaseProfiler {
+public:
+    explicit PhaseProfiler(bool enable);
+    void Begin(const std::string& phase);
+    void End();
+    /**
+     * @brief Prints the counters, IPC and cache miss rate of every phase, in the order they first began.
+     */
+    void Print(std::ostream& os) const;
+
+private:
+    struct Phase {
+        std::string name;
+        int runs = 0;
+        double wall_ms = 0;
+        PerfCounters::Counts counts{};
+    };
+
+    std::unique_ptr<PerfCounters> counters;
+    std::vector<Phase> phases;
+    int current = -1;
+    PerfCounters::Counts begin_counts{};
+    std::chrono::steady_clock::time_point begin_time;
+};
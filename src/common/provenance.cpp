@@ -0,0 +1,36 @@
+#include "provenance.hpp"
+#include <sstream>
+
+void ChunkProvenance::SetOrigin(int rank, size_t index) {
+    origin_rank = rank;
+    origin_index = static_cast<uint32_t>(index);
+    num_hops = 0;
+}
+
+void ChunkProvenance::Clear() {
+    origin_rank = -1;
+    num_hops = 0;
+}
+
+void ChunkProvenance::AddHop(int rank, int tbid, int step, OpType op) {
+    hops[num_hops % MAX_HOPS] = {rank, static_cast<int16_t>(tbid), static_cast<uint8_t>(step), static_cast<uint8_t>(op)};
+    ++num_hops;
+}
+
+std::string ChunkProvenance::ToString() const {
+    if (origin_rank < 0) {
+        return "never written in this run";
+    }
+    std::ostringstream os;
+    os << "input[" << origin_index << "] of rank " << origin_rank;
+    uint32_t first = 0;
+    if (num_hops > MAX_HOPS) {
+        first = num_hops - MAX_HOPS;
+        os << " -> (" << first << " earlier hops)";
+    }
+    for (uint32_t i = first; i < num_hops; ++i) {
+        const ChunkHop &hop = hops[i % MAX_HOPS];
+        os << " -> rank " << hop.rank << " tb " << hop.tbid << " step " << static_cast<int>(hop.step) << " (" << static_cast<OpType>(hop.op) << ")";
+    }
+    return os.str();
+}
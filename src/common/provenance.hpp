@@ -0,0 +1,42 @@
+#pragma once
+#include "instructions.hpp"
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief A step that moved a chunk.
+ */
+struct ChunkHop {
+    int32_t rank;
+    int16_t tbid;
+    uint8_t step; // Steps are limited to 256 per threadblock
+    uint8_t op;
+};
+
+/**
+ * @brief Where a chunk came from: its origin in an input buffer and the last hops that moved it.
+ *
+ * Hops are kept in a fixed-size ring, so tracking costs a small copy per chunk and step no
+ * matter how long the path is. Only the most recent MAX_HOPS hops are kept.
+ */
+class ChunkProvenance {
+public:
+    static const uint32_t MAX_HOPS = 8;
+
+    /**
+     * @brief Marks the chunk as the initial value of an input buffer element.
+     */
+    void SetOrigin(int rank, size_t index);
+    /**
+     * @brief Marks the chunk as never written in this run.
+     */
+    void Clear();
+    void AddHop(int rank, int tbid, int step, OpType op);
+    std::string ToString() const;
+
+private:
+    int32_t origin_rank = -1; // -1 if never written
+    uint32_t origin_index = 0;
+    uint32_t num_hops = 0; // Total number of hops, including the ones dropped from the ring
+    ChunkHop hops[MAX_HOPS];
+};
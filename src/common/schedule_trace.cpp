@@ -0,0 +1,100 @@
+#include "schedule_trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static const char TRACE_MAGIC[8] = {'M', 'S', 'C', 'C', 'L', 'T', 'R', 'C'};
+static const uint32_t TRACE_VERSION = 1;
+
+template <typename T>
+static void WriteValue(std::ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static T ReadValue(std::ifstream& in) {
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Truncated schedule trace.");
+    }
+    return value;
+}
+
+void ScheduleTrace::Save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Cannot open schedule trace " + path + " for writing.");
+    }
+    out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    WriteValue<uint32_t>(out, TRACE_VERSION);
+    WriteValue<uint32_t>(out, num_ranks);
+    WriteValue<uint64_t>(out, total_steps);
+    WriteValue<uint64_t>(out, seed);
+    WriteValue<uint32_t>(out, iteration);
+    WriteValue<uint64_t>(out, entries.size());
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+    if (!out) {
+        throw std::runtime_error("Failed to write schedule trace " + path + ".");
+    }
+}
+
+ScheduleTrace ScheduleTrace::Load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Cannot open schedule trace " + path + ".");
+    }
+    char magic[sizeof(TRACE_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error(path + " is not a schedule trace.");
+    }
+    uint32_t version = ReadValue<uint32_t>(in);
+    if (version != TRACE_VERSION) {
+        throw std::runtime_error("Unsupported schedule trace version " + std::to_string(version) + ".");
+    }
+    ScheduleTrace trace;
+    trace.num_ranks = ReadValue<uint32_t>(in);
+    trace.total_steps = ReadValue<uint64_t>(in);
+    trace.seed = ReadValue<uint64_t>(in);
+    trace.iteration = ReadValue<uint32_t>(in);
+    uint64_t num_entries = ReadValue<uint64_t>(in);
+    if (num_entries > trace.total_steps) {
+        throw std::runtime_error("Schedule trace has more entries (" + std::to_string(num_entries) + ") than steps (" + std::to_string(trace.total_steps) + ").");
+    }
+    trace.entries.resize(num_entries);
+    if (!in.read(reinterpret_cast<char*>(trace.entries.data()), num_entries * sizeof(Entry))) {
+        throw std::runtime_error("Truncated schedule trace.");
+    }
+    return trace;
+}
+
+ScheduleRecorder::ScheduleRecorder(uint32_t num_ranks, uint64_t total_steps): num_ranks(num_ranks), entries(total_steps) {
+    if (num_ranks > UINT16_MAX) {
+        throw std::runtime_error("Schedule traces support at most " + std::to_string(UINT16_MAX) + " ranks.");
+    }
+}
+
+void ScheduleRecorder::Reset() {
+    num_entries.store(0, std::memory_order_relaxed);
+}
+
+void ScheduleRecorder::Record(int rank, int tbid) {
+    if (tbid >= ScheduleTrace::SKIP_FLAG) {
+        throw std::runtime_error("Schedule traces support at most " + std::to_string(ScheduleTrace::SKIP_FLAG) + " threadblocks per rank.");
+    }
+    size_t index = num_entries.fetch_add(1, std::memory_order_relaxed);
+    if (index < entries.size()) {
+        entries[index] = {static_cast<uint16_t>(rank), static_cast<uint16_t>(tbid)};
+    }
+}
+
+ScheduleTrace ScheduleRecorder::getTrace(uint64_t seed, uint32_t iteration) const {
+    ScheduleTrace trace;
+    trace.num_ranks = num_ranks;
+    trace.total_steps = entries.size();
+    trace.seed = seed;
+    trace.iteration = iteration;
+    size_t count = std::min(num_entries.load(std::memory_order_relaxed), entries.size());
+    trace.entries.assign(entries.begin(), entries.begin() + count);
+    return trace;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The order in which the steps of one run completed.
+ *
+ * Each entry names the threadblock that completed its next step; the step itself is implicit
+ * in program order. Messages are delivered in FIFO order per channel, so the entries also
+ * determine which message every receiving step consumed.
+ *
+ * A minimized trace may mark entries as skipped: such steps run as nops that only publish
+ * themselves to dependent steps.
+ *
+ * On disk, a trace is a fixed header followed by 4 bytes per entry, in host byte order.
+ */
+struct ScheduleTrace {
+    struct Entry {
+        uint16_t rank;
+        uint16_t tbid; // SKIP_FLAG is set if the step runs as a nop
+    };
+    static const uint16_t SKIP_FLAG = 0x8000;
+
+    uint32_t num_ranks = 0;
+    uint64_t total_steps = 0; // Number of steps in the XML, to detect traces of other algorithms
+    uint64_t seed = 0;
+    uint32_t iteration = 0;
+    std::vector<Entry> entries;
+
+    void Save(const std::string& path) const;
+    static ScheduleTrace Load(const std::string& path);
+};
+
+/**
+ * @brief Collects the schedule of a run from concurrently executing threadblocks.
+ *
+ * Every step of the XML completes exactly once per run, so entries go into a preallocated
+ * array at an index claimed with a single atomic increment.
+ */
+class ScheduleRecorder {
+public:
+    ScheduleRecorder(uint32_t num_ranks, uint64_t total_steps);
+    /**
+     * @brief Forgets the recorded entries before a new run.
+     */
+    void Reset();
+    /**
+     * @brief Records that a threadblock completed its next step.
+     * Must be called before the effects of the step become visible to other threadblocks.
+     */
+    void Record(int rank, int tbid);
+    ScheduleTrace getTrace(uint64_t seed, uint32_t iteration) const;
+
+private:
+    uint32_t num_ranks;
+    std::vector<ScheduleTrace::Entry> entries;
+    std::atomic<size_t> num_entries{0};
+};
@@ -0,0 +1,234 @@
+#include "scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+
+SerialExecutor::SerialExecutor(std::shared_ptr<CommGroup> comm_group): comm_group(comm_group) {
+    int num_ranks = comm_group->getNumRanks();
+    active_tbs.assign(num_ranks, 0);
+    for (int r = 0; r < num_ranks; ++r) {
+        auto rank = comm_group->getRank(r);
+        rank->ResetInstructionSteps();
+        rank_first_slot.push_back(slots.size());
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            auto tb = rank->getThreadBlock(t);
+            int num_steps = tb->getInstructions().size();
+            if (tb->getRecvMailbox()) {
+                mailbox_receiver[tb->getRecvMailbox().get()] = slots.size();
+            }
+            slots.push_back({r, static_cast<int>(t), tb, 0, num_steps});
+            total_steps += num_steps;
+            if (num_steps == 0) {
+                ++finished_slots;
+            }
+        }
+    }
+    rank_first_slot.push_back(slots.size());
+}
+
+size_t SerialExecutor::getNumSlots() const {
+    return slots.size();
+}
+
+size_t SerialExecutor::getTotalSteps() const {
+    return total_steps;
+}
+
+int SerialExecutor::getSlotRank(size_t slot) const {
+    return slots.at(slot).rank_id;
+}
+
+int SerialExecutor::getSlotTbId(size_t slot) const {
+    return slots.at(slot).tbid;
+}
+
+int SerialExecutor::getNextStep(size_t slot) const {
+    return slots.at(slot).next_step;
+}
+
+size_t SerialExecutor::getSlot(int rank_id, int tbid) const {
+    if (rank_id < 0 || rank_id + 1 >= static_cast<int>(rank_first_slot.size()) ||
+        tbid < 0 || rank_first_slot[rank_id] + tbid >= rank_first_slot[rank_id + 1]) {
+        throw std::runtime_error("Invalid threadblock " + std::to_string(tbid) + " in rank " + std::to_string(rank_id) + ".");
+    }
+    return rank_first_slot[rank_id] + tbid;
+}
+
+bool SerialExecutor::IsSlotFinished(size_t slot) const {
+    return slots.at(slot).next_step >= slots.at(slot).num_steps;
+}
+
+bool SerialExecutor::IsFinished() const {
+    return finished_slots == slots.size();
+}
+
+bool SerialExecutor::IsRunnable(size_t slot, bool skip) const {
+    const Slot &s = slots.at(slot);
+    if (s.next_step >= s.num_steps) {
+        return false;
+    }
+    if (s.next_step == 0 && active_tbs[s.rank_id] >= NUM_GPU_SMS) {
+        return false; // Not started yet and all SMs are taken
+    }
+    return skip ? s.tb->IsDependencyMet(s.next_step) : s.tb->IsStepReady(s.next_step);
+}
+
+void SerialExecutor::Step(size_t slot, bool skip) {
+    Slot &s = slots.at(slot);
+    if (s.next_step == 0) {
+        ++active_tbs[s.rank_id];
+    }
+    if (skip) {
+        s.tb->SkipSingleStep(s.next_step);
+    } else {
+        s.tb->ExecuteSingleStep(s.next_step);
+    }
+    ++s.next_step;
+    if (s.next_step == s.num_steps) {
+        --active_tbs[s.rank_id];
+        ++finished_slots;
+    }
+}
+
+void SerialExecutor::CollectAffectedSlots(size_t slot, std::vector<size_t>& affected) const {
+    const Slot &s = slots.at(slot);
+    affected.push_back(slot);
+    if (s.next_step > 0 && IsSendOp(s.tb->getInstructions()[s.next_step - 1].op)) {
+        auto it = mailbox_receiver.find(s.tb->getSendMailbox().get());
+        if (it != mailbox_receiver.end()) {
+            affected.push_back(it->second);
+        }
+    }
+    for (size_t i = rank_first_slot[s.rank_id]; i < rank_first_slot[s.rank_id + 1]; ++i) {
+        if (i != slot && !IsSlotFinished(i)) {
+            affected.push_back(i);
+        }
+    }
+}
+
+std::string SerialExecutor::DescribeBlockedSlots() const {
+    static const size_t MAX_REPORTED = 16;
+    std::ostringstream os;
+    size_t reported = 0, blocked = 0;
+    for (const auto &s : slots) {
+        if (s.next_step >= s.num_steps) {
+            continue;
+        }
+        ++blocked;
+        if (reported == MAX_REPORTED) {
+            continue;
+        }
+        ++reported;
+        const Instruction &inst = s.tb->getInstructions()[s.next_step];
+        os << "  Rank " << s.rank_id << " ThreadBlock " << s.tbid << " step " << s.next_step << " (" << inst.op << "): waiting for ";
+        if (s.next_step == 0 && active_tbs[s.rank_id] >= NUM_GPU_SMS) {
+            os << "a free SM";
+        } else if (!s.tb->IsDependencyMet(s.next_step)) {
+            os << "step " << inst.dep_step << " of ThreadBlock " << inst.dep_tbid;
+        } else if (IsRecvOp(inst.op)) {
+            os << "a message from rank " << s.tb->getRecvPeer() << " on channel " << s.tb->getChanId();
+        }
+        os << "\n";
+    }
+    if (blocked > reported) {
+        os << "  ... and " << blocked - reported << " more threadblocks\n";
+    }
+    return os.str();
+}
+
+PctScheduler::PctScheduler(int depth, unsigned int seed): depth(depth), rng(seed) {
+    if (depth < 1) {
+        throw std::runtime_error("PCT depth must be at least 1, got " + std::to_string(depth) + ".");
+    }
+}
+
+void PctScheduler::ExecuteRanks(std::shared_ptr<CommGroup> comm_group) {
+    SerialExecutor executor(comm_group);
+    size_t num_slots = executor.getNumSlots();
+    size_t total_steps = executor.getTotalSteps();
+
+    // Initial priorities are depth, ..., depth + n - 1; change point i (from 1) lowers the running slot to depth - i,
+    // below every initial priority and every earlier demotion
+    std::vector<int> priority(num_slots);
+    std::iota(priority.begin(), priority.end(), depth);
+    std::shuffle(priority.begin(), priority.end(), rng);
+    // Distinct change points from [1, total_steps], drawn without replacement by Floyd's algorithm
+    std::set<size_t> distinct_points;
+    const size_t num_points = std::min(static_cast<size_t>(depth - 1), total_steps);
+    for (size_t j = total_steps - num_points + 1; j <= total_steps; ++j) {
+        size_t t = std::uniform_int_distribution<size_t>(1, j)(rng);
+        distinct_points.insert(distinct_points.count(t) ? j : t);
+    }
+    std::vector<size_t> change_points(distinct_points.begin(), distinct_points.end());
+
+    std::set<std::pair<int, size_t>> runnable; // (priority, slot)
+    for (size_t slot = 0; slot < num_slots; ++slot) {
+        if (executor.IsRunnable(slot)) {
+            runnable.insert({priority[slot], slot});
+        }
+    }
+
+    size_t steps = 0, next_change = 0;
+    std::vector<size_t> affected;
+    while (!executor.IsFinished()) {
+        if (runnable.empty()) {
+            throw std::runtime_error("Deadlock: no threadblock can make progress after " + std::to_string(steps) + " steps.\n" + executor.DescribeBlockedSlots());
+        }
+        size_t slot = std::prev(runnable.end())->second;
+        executor.Step(slot);
+        ++steps;
+
+        affected.clear();
+        executor.CollectAffectedSlots(slot, affected);
+        for (size_t s : affected) {
+            runnable.erase({priority[s], s});
+        }
+        while (next_change < change_points.size() && change_points[next_change] == steps) {
+            priority[slot] = depth - static_cast<int>(++next_change);
+        }
+        for (size_t s : affected) {
+            if (executor.IsRunnable(s)) {
+                runnable.insert({priority[s], s});
+            }
+        }
+    }
+}
+
+void PctScheduler::PrintBound(std::shared_ptr<CommGroup> comm_group, std::ostream& os) const {
+    SerialExecutor executor(comm_group);
+    double n = executor.getNumSlots();
+    double k = executor.getTotalSteps();
+    double bound = 1.0 / (n * std::pow(k, depth - 1));
+    os << "PCT scheduler: " << executor.getNumSlots() << " threadblocks, " << executor.getTotalSteps() << " steps, depth " << depth
+       << "; each run hits a depth-" << depth << " bug with probability >= " << bound << std::endl;
+}
+
+void ReplaySchedule(std::shared_ptr<CommGroup> comm_group, const ScheduleTrace& trace) {
+    if (trace.num_ranks != comm_group->getNumRanks() || trace.total_steps != comm_group->getNumSteps()) {
+        throw std::runtime_error("Schedule trace was recorded for " + std::to_string(trace.num_ranks) + " ranks and " + std::to_string(trace.total_steps) +
+                                 " steps, but the XML has " + std::to_string(comm_group->getNumRanks()) + " ranks and " + std::to_string(comm_group->getNumSteps()) + " steps.");
+    }
+    SerialExecutor executor(comm_group);
+    for (size_t i = 0; i < trace.entries.size(); ++i) {
+        int tbid = trace.entries[i].tbid & ~ScheduleTrace::SKIP_FLAG;
+        bool skip = (trace.entries[i].tbid & ScheduleTrace::SKIP_FLAG) != 0;
+        size_t slot = executor.getSlot(trace.entries[i].rank, tbid);
+        if (!executor.IsRunnable(slot, skip)) {
+            throw std::runtime_error("Schedule trace diverges at entry " + std::to_string(i) + ": step " + std::to_string(executor.getNextStep(slot)) +
+                                     " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(trace.entries[i].rank) + " cannot run.");
+        }
+        executor.Step(slot, skip);
+    }
+    size_t slot = 0;
+    while (!executor.IsFinished()) {
+        size_t start = slot;
+        while (!executor.IsRunnable(slot)) {
+            slot = (slot + 1) % executor.getNumSlots();
+            if (slot == start) {
+                throw std::runtime_error("Deadlock: no threadblock can make progress after the end of the schedule trace.\n" + executor.DescribeBlockedSlots());
+            }
+        }
+        executor.Step(slot);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "threadblock.hpp"
+
+/**
+ * @brief Executes the threadblocks of a CommGroup one step at a time on the calling thread.
+ *
+ * Each threadblock is a slot with a cursor to its next step. A slot is runnable if its next
+ * step is ready and, for a threadblock that has not started yet, its rank has a free SM.
+ * Messages and dependencies produced by a step are visible to the following steps immediately,
+ * so the order of Step calls fully determines the execution.
+ */
+class SerialExecutor {
+public:
+    explicit SerialExecutor(std::shared_ptr<CommGroup> comm_group);
+
+    size_t getNumSlots() const;
+    size_t getTotalSteps() const;
+    int getSlotRank(size_t slot) const;
+    int getSlotTbId(size_t slot) const;
+    int getNextStep(size_t slot) const;
+    /**
+     * @brief Returns the slot of a threadblock.
+     */
+    size_t getSlot(int rank_id, int tbid) const;
+
+    bool IsSlotFinished(size_t slot) const;
+    bool IsFinished() const;
+    /**
+     * @brief Checks if the next step of a slot can run, or only be skipped if skip is true.
+     */
+    bool IsRunnable(size_t slot, bool skip = false) const;
+    /**
+     * @brief Executes (or skips) the next step of a slot. The slot must be runnable.
+     */
+    void Step(size_t slot, bool skip = false);
+    /**
+     * @brief Collects the slots whose runnability may have changed by the last step of a slot.
+     *
+     * These are the slot itself, the receiver of a message it sent, and the unfinished slots of
+     * its rank (which may wait for a dependency or an SM).
+     */
+    void CollectAffectedSlots(size_t slot, std::vector<size_t>& affected) const;
+    /**
+     * @brief Describes the slots that cannot make progress, for deadlock reports.
+     */
+    std::string DescribeBlockedSlots() const;
+
+private:
+    struct Slot {
+        int rank_id;
+        int tbid;
+        std::shared_ptr<ThreadBlock> tb;
+        int next_step;
+        int num_steps;
+    };
+
+    std::shared_ptr<CommGroup> comm_group;
+    std::vector<Slot> slots;
+    std::vector<size_t> rank_first_slot; // Slots of rank r are [rank_first_slot[r], rank_first_slot[r + 1])
+    std::vector<int> active_tbs; // Per rank: number of started but unfinished threadblocks
+    std::map<const Mailbox*, size_t> mailbox_receiver; // Receive mailbox -> slot
+    size_t total_steps = 0;
+    size_t finished_slots = 0;
+};
+
+/**
+ * @brief Probabilistic concurrency testing (PCT) scheduler.
+ *
+ * Threadblocks get distinct random priorities and the highest-priority runnable threadblock
+ * always runs. At depth-1 random points of the execution, the running threadblock is demoted
+ * below all others. For n threadblocks and k steps in total, every run hits a given bug of
+ * depth d with probability at least 1 / (n * k^(d-1)).
+ */
+class PctScheduler {
+public:
+    PctScheduler(int depth, unsigned int seed);
+    /**
+     * @brief Executes one run of all ranks.
+     * Throws if no threadblock can make progress before all of them have finished.
+     */
+    void ExecuteRanks(std::shared_ptr<CommGroup> comm_group);
+    /**
+     * @brief Prints the per-run probability bound of hitting a depth-d bug.
+     */
+    void PrintBound(std::shared_ptr<CommGroup> comm_group, std::ostream& os) const;
+
+private:
+    int depth;
+    std::mt19937 rng;
+};
+
+/**
+ * @brief Re-executes a recorded schedule on the calling thread.
+ *
+ * Throws if the trace was recorded for another XML, or if a recorded step cannot run at its
+ * position. A trace of a failed run ends early; its remaining steps run in threadblock order.
+ */
+void ReplaySchedule(std::shared_ptr<CommGroup> comm_group, const ScheduleTrace& trace);
@@ -0,0 +1,122 @@
+#include "shm_transport.hpp"
+#include "mailbox.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SharedMemorySegment::SharedMemorySegment(size_t size): length(size) {
+    static std::atomic<int> counter{0};
+    std::string name = "/msccl-verifier-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create shared memory " + name + ": " + strerror(errno));
+    }
+    shm_unlink(name.c_str());
+    if (ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error("Cannot allocate " + std::to_string(length) + " bytes of shared memory: " + strerror(err));
+    }
+    base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        throw std::runtime_error("Cannot map " + std::to_string(length) + " bytes of shared memory: " + strerror(err));
+    }
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+    if (base) {
+        munmap(base, length);
+    }
+}
+
+void* SharedMemorySegment::data() const {
+    return base;
+}
+
+size_t SharedMemorySegment::size() const {
+    return length;
+}
+
+size_t SharedRing::RegionSize(size_t capacity) {
+    return sizeof(Header) + capacity * sizeof(uint64_t);
+}
+
+SharedRing::SharedRing(void* region, size_t capacity):
+    header(static_cast<Header*>(region)),
+    words(reinterpret_cast<uint64_t*>(static_cast<char*>(region) + sizeof(Header))),
+    capacity(capacity) {}
+
+bool SharedRing::TryPush(const std::vector<uint64_t>& record) {
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    size_t needed = 1 + record.size(); // Length word, then the record
+    if (capacity - (tail - head) < needed) {
+        return false;
+    }
+    words[tail % capacity] = record.size();
+    for (size_t i = 0; i < record.size(); ++i) {
+        words[(tail + 1 + i) % capacity] = record[i];
+    }
+    header->tail.store(tail + needed, std::memory_order_release);
+    return true;
+}
+
+bool SharedRing::TryPop(std::vector<uint64_t>& record) {
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    if (head == header->tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    record.resize(words[head % capacity]);
+    for (size_t i = 0; i < record.size(); ++i) {
+        record[i] = words[(head + 1 + i) % capacity];
+    }
+    header->head.store(head + 1 + record.size(), std::memory_order_release);
+    return true;
+}
+
+bool SharedRing::Empty() const {
+    return header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_acquire);
+}
+
+void SharedRing::Reset() {
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_release);
+}
+
+void EncodeMessage(const Message& msg, int64_t sent_ns, std::vector<uint64_t>& record) {
+    record.clear();
+    record.push_back(static_cast<uint64_t>(msg.src_buff));
+    record.push_back(static_cast<uint64_t>(msg.src_off));
+    record.push_back(static_cast<uint64_t>(msg.dst_buff));
+    record.push_back(static_cast<uint64_t>(msg.dst_off));
+    record.push_back(static_cast<uint64_t>(sent_ns));
+    record.push_back(msg.chunks.size());
+    for (const auto& chunk : msg.chunks) {
+        chunk.AppendWords(record);
+    }
+}
+
+void DecodeMessage(const std::vector<uint64_t>& record, Message& msg) {
+    msg.src_buff = static_cast<BufferType>(record[0]);
+    msg.src_off = static_cast<std::ptrdiff_t>(record[1]);
+    msg.dst_buff = static_cast<BufferType>(record[2]);
+    msg.dst_off = static_cast<std::ptrdiff_t>(record[3]);
+    msg.sent_ns = static_cast<int64_t>(record[4]);
+    msg.chunks.resize(record[5]);
+    msg.provenance.clear();
+    size_t pos = 6;
+    for (auto& chunk : msg.chunks) {
+        chunk = ChunkDataType::ReadWords(record.data(), pos);
+    }
+}
+
+size_t MaxMessageWords(size_t num_chunks, int num_ranks) {
+    return 1 + 6 + num_chunks * ChunkDataType::MaxWords(num_ranks); // Length word, header, chunks
+}
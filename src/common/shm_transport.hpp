@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Message;
+
+/**
+ * @brief A POSIX shared-memory segment, mapped before forking so that child processes share it.
+ *
+ * The name is unlinked as soon as the segment is mapped, so nothing is left behind if a process
+ * crashes. The memory is zero-filled.
+ */
+class SharedMemorySegment {
+public:
+    explicit SharedMemorySegment(size_t size);
+    ~SharedMemorySegment();
+    SharedMemorySegment(const SharedMemorySegment&) = delete;
+    SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+    void* data() const;
+    size_t size() const;
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * @brief A lock-free single-producer single-consumer ring of variable-length records of words.
+ *
+ * The ring is a view over shared memory: the positions and the words live in the region given
+ * to the constructor, so a producer and a consumer in different processes can use it. Every
+ * mailbox has exactly one sending and one receiving threadblock, which makes it SPSC.
+ */
+class SharedRing {
+public:
+    /**
+     * @brief Returns the bytes of shared memory needed for a ring of capacity words.
+     */
+    static size_t RegionSize(size_t capacity);
+
+    SharedRing(void* region, size_t capacity);
+    /**
+     * @brief Appends a record. Returns false without writing if the ring has no room for it.
+     */
+    bool TryPush(const std::vector<uint64_t>& record);
+    /**
+     * @brief Removes the oldest record. Returns false if the ring is empty.
+     */
+    bool TryPop(std::vector<uint64_t>& record);
+    bool Empty() const;
+    /**
+     * @brief Drops all records. Neither side may use the ring concurrently.
+     */
+    void Reset();
+
+private:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> head; // Words consumed, written by the consumer
+        alignas(64) std::atomic<uint64_t> tail; // Words produced, written by the producer
+    };
+
+    Header* header;
+    uint64_t* words;
+    size_t capacity;
+};
+
+/**
+ * @brief Encodes a message, sent at sent_ns, as one record of words. Provenance is not encoded.
+ * The record is overwritten, so a caller can reuse it for every message.
+ */
+void EncodeMessage(const Message& msg, int64_t sent_ns, std::vector<uint64_t>& record);
+void DecodeMessage(const std::vector<uint64_t>& record, Message& msg);
+/**
+ * @brief The most words EncodeMessage writes for a message of num_chunks chunks in a group of num_ranks ranks.
+ */
+size_t MaxMessageWords(size_t num_chunks, int num_ranks);
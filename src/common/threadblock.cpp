@@ -1,6 +1,28 @@
 #include "threadblock.hpp"
+#include <exception>
+#include <iomanip>
+
+/**
+ * @brief Keeps the first exception thrown by a group of threads, to rethrow it after joining them.
+ */
+class FirstError {
+public:
+    void Capture() {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+    void RethrowIfAny() const {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 
-static const int NUM_GPU_SMS = 78; // 78 SMs on a Nvidia H20 GPU
+private:
+    std::exception_ptr error;
+    std::mutex errorMutex;
+};
 
 void ThreadBlock::Initialize(tinyxml2::XMLElement* tb_elem, std::shared_ptr<GpuRank> my_rank) {
     tbid = std::stoi(SafeGetAttribute(tb_elem, "id"));
@@ -9,20 +31,11 @@ void ThreadBlock::Initialize(tinyxml2::XMLElement* tb_elem, std::shared_ptr<GpuR
     chan_id = std::stoi(SafeGetAttribute(tb_elem, "chan"));
     
     gpu_rank = my_rank;
-    if (send_peer >= 0) {
-        if (send_peer == gpu_rank->rank) {
-            throw std::runtime_error("ThreadBlock " + std::to_string(tbid) + " in rank " + std::to_string(gpu_rank->rank) + " cannot send to itself.");
-        }
-        bool result = gpu_rank->comm_group->mailboxManager->getSendMailbox(gpu_rank->rank, send_peer, chan_id, send_mailbox);
-        if (!result) {
-            throw std::runtime_error("Mailbox already existed for ThreadBlock " + std::to_string(tbid) + " in rank " + std::to_string(gpu_rank->rank) + ".");
-        }
+    if (send_peer >= 0 && send_peer == gpu_rank->rank) {
+        throw std::runtime_error("ThreadBlock " + std::to_string(tbid) + " in rank " + std::to_string(gpu_rank->rank) + " cannot send to itself.");
     }
-    if (recv_peer >= 0) {
-        if (recv_peer == gpu_rank->rank) {
-            throw std::runtime_error("ThreadBlock " + std::to_string(tbid) + " in rank " + std::to_string(gpu_rank->rank) + " cannot receive from itself.");
-        }
-        gpu_rank->comm_group->mailboxManager->getRecvMailbox(recv_peer, gpu_rank->rank, chan_id, recv_mailbox);
+    if (recv_peer >= 0 && recv_peer == gpu_rank->rank) {
+        throw std::runtime_error("ThreadBlock " + std::to_string(tbid) + " in rank " + std::to_string(gpu_rank->rank) + " cannot receive from itself.");
     }
 
     LoadInstructions(tb_elem);
@@ -72,7 +85,72 @@ const std::vector<Instruction>& ThreadBlock::getInstructions() const {
     return instructions;
 }
 
+DataMismatchError::DataMismatchError(int rank, size_t index, const ChunkDataType& expected, const ChunkDataType& actual, const std::string& provenance):
+    std::runtime_error("Data mismatch in output buffer at index " + std::to_string(index) + " in rank " + std::to_string(rank) + ": Expected " + expected.ToString() + ", but got " + actual.ToString() + "." +
+                       (provenance.empty() ? "" : "\n  Provenance: " + provenance)),
+    rank(rank), index(index), expected(expected), actual(actual) {}
+
+int ThreadBlock::getTbId() const {
+    return tbid;
+}
+
+int ThreadBlock::getSendPeer() const {
+    return send_peer;
+}
+
+int ThreadBlock::getRecvPeer() const {
+    return recv_peer;
+}
+
+int ThreadBlock::getChanId() const {
+    return chan_id;
+}
+
+std::shared_ptr<Mailbox> ThreadBlock::getSendMailbox() const {
+    return send_mailbox;
+}
+
+std::shared_ptr<Mailbox> ThreadBlock::getRecvMailbox() const {
+    return recv_mailbox;
+}
+
+bool ThreadBlock::IsDependencyMet(int step) const {
+    const Instruction &inst = instructions.at(step);
+    if (inst.dep_tbid < 0 || inst.dep_step < 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(gpu_rank->instructionMutex);
+    return gpu_rank->instructionSteps.count({inst.dep_tbid, inst.dep_step}) > 0;
+}
+
+bool ThreadBlock::IsStepReady(int step) const {
+    const Instruction &inst = instructions.at(step);
+    if (!IsDependencyMet(step)) {
+        return false;
+    }
+    if (IsRecvOp(inst.op)) {
+        return recv_mailbox && !recv_mailbox->isEmpty();
+    }
+    return true;
+}
+
 void ThreadBlock::ExecuteSingleStep(int step) {
+    // The only cost of tracing and wait statistics when both are disabled
+    if (timed) {
+        ExecuteStep<true>(step);
+    } else {
+        ExecuteStep<false>(step);
+    }
+}
+
+template <bool Timed>
+void ThreadBlock::ExecuteStep(int step) {
+    int64_t step_begin = 0, recv_wait_before = 0;
+    if constexpr (Timed) {
+        step_begin = Tracer::Now();
+        recv_wait_before = wait_stats.recv_wait_ns;
+    }
+    int64_t dep_wait = 0;
     const Instruction &inst = instructions.at(step);
     // Check if the dependency is met
     if (inst.dep_tbid >= 0 || inst.dep_step >= 0) {
@@ -80,7 +158,8 @@ void ThreadBlock::ExecuteSingleStep(int step) {
             throw std::runtime_error("Invalid dependency in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
         }
         bool timeout = true;
-        for (int tries = 0; tries < MAX_TRIES; ++tries) {
+        int tries = 0;
+        for (; tries < MAX_TRIES; ++tries) {
             {
                 std::lock_guard<std::mutex> lock(gpu_rank->instructionMutex);
                 if (gpu_rank->instructionSteps.count({inst.dep_tbid, inst.dep_step}) > 0) {
@@ -90,11 +169,23 @@ void ThreadBlock::ExecuteSingleStep(int step) {
             }
             std::this_thread::sleep_for(SLEEP_TIME);
         }
+        if constexpr (Timed) {
+            if (tries > 0) {
+                int64_t dep_end = Tracer::Now();
+                dep_wait = dep_end - step_begin;
+                wait_stats.dep_wait_ns += dep_wait;
+                if (trace_buffer) {
+                    trace_buffer->Record(TraceEvent::Kind::dep_wait, step, inst.op, step_begin, dep_end);
+                }
+            }
+        }
         if (timeout) {
             throw std::runtime_error("Dependency not met in time for instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
         }
     }
     // Execute the instruction based on its operation type
+    Message out_msg; // Sent after the step is recorded
+    const bool track_provenance = gpu_rank->comm_group->track_provenance;
     switch (inst.op) {
         case OpType::copy: {
             const auto &src_buffer = gpu_rank->buffers[inst.src_buff];
@@ -106,27 +197,48 @@ void ThreadBlock::ExecuteSingleStep(int step) {
             // std::lock_guard<std::mutex> lock(gpu_rank->bufferMutex);
             std::copy(src_buffer.begin() + inst.src_off, src_buffer.begin() + inst.src_off + inst.num_chunks,
                       dst_buffer.begin() + inst.dst_off);
+            if (track_provenance) {
+                const auto &src_provenance = gpu_rank->provenance[inst.src_buff];
+                auto &dst_provenance = gpu_rank->provenance[inst.dst_buff];
+                for (size_t i = 0; i < inst.num_chunks; ++i) {
+                    dst_provenance[inst.dst_off + i] = src_provenance[inst.src_off + i];
+                    dst_provenance[inst.dst_off + i].AddHop(gpu_rank->rank, tbid, step, inst.op);
+                }
+            }
             break;
         }
-        case OpType::recv: {
-            Message msg;
-            if (!recv_mailbox->receiveMessage(msg)) {
-                throw std::runtime_error("Failed to receive message in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
-            }
+        case OpType::reduce: {
+            const auto &src_buffer = gpu_rank->buffers[inst.src_buff];
             auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
-            if (inst.dst_off < 0 || inst.dst_off + msg.chunks.size() > dst_buffer.size()) {
-                throw std::runtime_error("Invalid destination buffer offset in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+            if (inst.src_off < 0 || inst.src_off + inst.num_chunks > src_buffer.size() ||
+                inst.dst_off < 0 || inst.dst_off + inst.num_chunks > dst_buffer.size()) {
+                throw std::runtime_error("Invalid buffer offsets in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
             }
-            if (msg.src_buff != inst.src_buff || msg.src_off != inst.src_off || msg.chunks.size() != inst.num_chunks ||
-                msg.dst_buff != inst.dst_buff || msg.dst_off != inst.dst_off) {
-                throw std::runtime_error("Message mismatch in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+            ReduceChunks(src_buffer.data() + inst.src_off, dst_buffer.data() + inst.dst_off, inst.num_chunks, step);
+            if (track_provenance) {
+                // A reduced chunk keeps the path of its latest operand
+                const auto &src_provenance = gpu_rank->provenance[inst.src_buff];
+                auto &dst_provenance = gpu_rank->provenance[inst.dst_buff];
+                for (size_t i = 0; i < inst.num_chunks; ++i) {
+                    dst_provenance[inst.dst_off + i] = src_provenance[inst.src_off + i];
+                    dst_provenance[inst.dst_off + i].AddHop(gpu_rank->rank, tbid, step, inst.op);
+                }
             }
+            break;
+        }
+        case OpType::recv: {
+            Message msg;
+            ReceiveMessage<Timed>(inst, step, msg);
+            auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
             // std::lock_guard<std::mutex> lock(gpu_rank->bufferMutex);
             std::copy(msg.chunks.begin(), msg.chunks.end(), dst_buffer.begin() + inst.dst_off);
+            if (track_provenance) {
+                RecordReceivedProvenance(msg, inst, step);
+            }
             break;
         }
         case OpType::send: {
-            Message msg;
+            Message &msg = out_msg;
             msg.chunks.resize(inst.num_chunks);
             msg.src_buff = inst.src_buff;
             msg.src_off = inst.src_off;
@@ -141,44 +253,201 @@ void ThreadBlock::ExecuteSingleStep(int step) {
                 // std::lock_guard<std::mutex> lock(gpu_rank->bufferMutex);
                 std::copy(src_buffer.begin() + inst.src_off, src_buffer.begin() + inst.src_off + inst.num_chunks, msg.chunks.begin());
             }
-            send_mailbox->sendMessage(msg);
+            if (track_provenance) {
+                const auto &src_provenance = gpu_rank->provenance[inst.src_buff];
+                msg.provenance.assign(src_provenance.begin() + inst.src_off, src_provenance.begin() + inst.src_off + inst.num_chunks);
+                for (auto &chunk_provenance : msg.provenance) {
+                    chunk_provenance.AddHop(gpu_rank->rank, tbid, step, inst.op);
+                }
+            }
             break;
         }
-        case OpType::rcs: {
+        case OpType::rrc: {
             Message msg;
-            if (!recv_mailbox->receiveMessage(msg)) {
-                throw std::runtime_error("Failed to receive message in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
-            }
+            ReceiveMessage<Timed>(inst, step, msg);
+            // dst = src + received; the local operand is read from src, which may differ from dst
+            const auto &src_buffer = gpu_rank->buffers[inst.src_buff];
             auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
-            if (inst.dst_off < 0 || inst.dst_off + msg.chunks.size() > dst_buffer.size()) {
-                throw std::runtime_error("Invalid destination buffer offset in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+            if (inst.src_off < 0 || inst.src_off + inst.num_chunks > src_buffer.size()) {
+                throw std::runtime_error("Invalid source buffer offset in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+            }
+            if (inst.src_buff == inst.dst_buff && inst.src_off == inst.dst_off) {
+                ReduceChunks(msg.chunks.data(), dst_buffer.data() + inst.dst_off, msg.chunks.size(), step);
+            } else {
+                std::vector<ChunkDataType> result(src_buffer.begin() + inst.src_off, src_buffer.begin() + inst.src_off + inst.num_chunks);
+                ReduceChunks(msg.chunks.data(), result.data(), result.size(), step);
+                std::copy(result.begin(), result.end(), dst_buffer.begin() + inst.dst_off);
             }
-            if (msg.src_buff != inst.src_buff || msg.src_off != inst.src_off || msg.chunks.size() != inst.num_chunks ||
-                msg.dst_buff != inst.dst_buff || msg.dst_off != inst.dst_off) {
-                throw std::runtime_error("Message mismatch in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+            if (track_provenance) {
+                RecordReceivedProvenance(msg, inst, step);
+            }
+            break;
+        }
+        case OpType::rrs: {
+            Message msg;
+            ReceiveMessage<Timed>(inst, step, msg);
+            // The reduction is forwarded without being written to the local buffer
+            const auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
+            ReduceChunks(dst_buffer.data() + inst.dst_off, msg.chunks.data(), msg.chunks.size(), step);
+            if (track_provenance) {
+                for (auto &chunk_provenance : msg.provenance) {
+                    chunk_provenance.AddHop(gpu_rank->rank, tbid, step, inst.op);
+                }
             }
+            msg.src_buff = msg.dst_buff;
+            msg.src_off = msg.dst_off;
+            out_msg = std::move(msg);
+            break;
+        }
+        case OpType::rrcs: {
+            Message msg;
+            ReceiveMessage<Timed>(inst, step, msg);
+            auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
+            ReduceChunks(msg.chunks.data(), dst_buffer.data() + inst.dst_off, msg.chunks.size(), step);
+            if (track_provenance) {
+                RecordReceivedProvenance(msg, inst, step);
+            }
+            msg.src_buff = msg.dst_buff;
+            msg.src_off = msg.dst_off;
+            std::copy(dst_buffer.begin() + inst.dst_off, dst_buffer.begin() + inst.dst_off + msg.chunks.size(), msg.chunks.begin());
+            out_msg = std::move(msg);
+            break;
+        }
+        case OpType::rcs: {
+            Message msg;
+            ReceiveMessage<Timed>(inst, step, msg);
+            auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
             {
                 // std::lock_guard<std::mutex> lock(gpu_rank->bufferMutex);
                 std::copy(msg.chunks.begin(), msg.chunks.end(), dst_buffer.begin() + inst.dst_off);
             }
+            if (track_provenance) {
+                RecordReceivedProvenance(msg, inst, step);
+            }
             msg.src_buff = msg.dst_buff;
             msg.src_off = msg.dst_off;
             {
                 // std::lock_guard<std::mutex> lock(gpu_rank->bufferMutex);
                 std::copy(dst_buffer.begin() + inst.dst_off, dst_buffer.begin() + inst.dst_off + msg.chunks.size(), msg.chunks.begin());
             }
-            send_mailbox->sendMessage(msg);
+            out_msg = std::move(msg);
             break;
         }
         case OpType::nop:
             break;
     }
 
+    // Record the step before its message or dependency becomes visible to other threadblocks
+    if (gpu_rank->comm_group->recorder) {
+        gpu_rank->comm_group->recorder->Record(gpu_rank->rank, tbid);
+    }
+    if (IsSendOp(inst.op)) {
+        send_mailbox->sendMessage(out_msg);
+    }
+
     // Update instruction step if other instructions depend on it
     if (inst.has_dep) {
         std::lock_guard<std::mutex> lock(gpu_rank->instructionMutex);
         gpu_rank->instructionSteps.insert({tbid, step});
     }
+    if constexpr (Timed) {
+        const int64_t step_end = Tracer::Now();
+        wait_stats.work_ns += step_end - step_begin - dep_wait - (wait_stats.recv_wait_ns - recv_wait_before);
+        if (trace_buffer) {
+            trace_buffer->Record(TraceEvent::Kind::step, step, inst.op, step_begin, step_end);
+        }
+    }
+}
+
+template <bool Timed>
+void ThreadBlock::ReceiveMessage(const Instruction& inst, int step, Message& msg) {
+    bool received;
+    if constexpr (Timed) {
+        const bool waiting = trace_buffer && recv_mailbox->isEmpty();
+        const int64_t wait_begin = Tracer::Now();
+        received = recv_mailbox->receiveMessage(msg);
+        const int64_t wait_end = Tracer::Now();
+        wait_stats.recv_wait_ns += wait_end - wait_begin;
+        if (waiting) {
+            trace_buffer->Record(TraceEvent::Kind::recv_wait, step, inst.op, wait_begin, wait_end);
+        }
+    } else {
+        received = recv_mailbox->receiveMessage(msg);
+    }
+    if (!received) {
+        throw std::runtime_error("Failed to receive message in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+    }
+    const auto &dst_buffer = gpu_rank->buffers[inst.dst_buff];
+    if (inst.dst_off < 0 || inst.dst_off + msg.chunks.size() > dst_buffer.size()) {
+        throw std::runtime_error("Invalid destination buffer offset in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+    }
+    if (msg.src_buff != inst.src_buff || msg.src_off != inst.src_off || msg.chunks.size() != inst.num_chunks ||
+        msg.dst_buff != inst.dst_buff || msg.dst_off != inst.dst_off) {
+        throw std::runtime_error("Message mismatch in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+    }
+}
+
+void ThreadBlock::ReduceChunks(const ChunkDataType* src, ChunkDataType* dst, size_t num_chunks, int step) const {
+    for (size_t i = 0; i < num_chunks; ++i) {
+        std::string reason;
+        switch (dst[i].Reduce(src[i])) {
+            case ChunkDataType::ReduceStatus::ok:
+                continue;
+            case ChunkDataType::ReduceStatus::empty_operand:
+                reason = "Reduction of an uninitialized chunk";
+                break;
+            case ChunkDataType::ReduceStatus::index_mismatch:
+                reason = "Reduction of chunks with different indices";
+                break;
+            case ChunkDataType::ReduceStatus::duplicate_contribution:
+                reason = "Duplicate contribution in reduction";
+                break;
+        }
+        throw std::runtime_error(reason + " (" + src[i].ToString() + " into " + dst[i].ToString() + ") in instruction step " + std::to_string(step) + " of ThreadBlock " + std::to_string(tbid) + " Rank " + std::to_string(gpu_rank->rank) + ".");
+    }
+}
+
+void ThreadBlock::RecordReceivedProvenance(Message& msg, const Instruction& inst, int step) {
+    auto &dst_provenance = gpu_rank->provenance[inst.dst_buff];
+    for (size_t i = 0; i < msg.provenance.size(); ++i) {
+        msg.provenance[i].AddHop(gpu_rank->rank, tbid, step, inst.op);
+        dst_provenance[inst.dst_off + i] = msg.provenance[i];
+    }
+}
+
+WaitStats& WaitStats::operator+=(const WaitStats& other) {
+    recv_wait_ns += other.recv_wait_ns;
+    dep_wait_ns += other.dep_wait_ns;
+    sm_wait_ns += other.sm_wait_ns;
+    work_ns += other.work_ns;
+    return *this;
+}
+
+int64_t WaitStats::BlockedNs() const {
+    return recv_wait_ns + dep_wait_ns + sm_wait_ns;
+}
+
+const WaitStats& ThreadBlock::getWaitStats() const {
+    return wait_stats;
+}
+
+void ThreadBlock::AddSmWait(int64_t ns) {
+    wait_stats.sm_wait_ns += ns;
+}
+
+void ThreadBlock::ResetWaitStats() {
+    wait_stats = WaitStats();
+}
+
+void ThreadBlock::SkipSingleStep(int step) {
+    const Instruction &inst = instructions.at(step);
+    if (gpu_rank->comm_group->recorder) {
+        gpu_rank->comm_group->recorder->Record(gpu_rank->rank, tbid);
+    }
+    if (inst.has_dep) {
+        std::lock_guard<std::mutex> lock(gpu_rank->instructionMutex);
+        gpu_rank->instructionSteps.insert({tbid, step});
+    }
 }
 
 void ThreadBlock::ExecuteInstructions() {
@@ -189,6 +458,11 @@ void ThreadBlock::ExecuteInstructions() {
     }
 }
 
+void ThreadBlock::Seed(unsigned int seed) {
+    std::seed_seq seq{seed, static_cast<unsigned int>(gpu_rank->rank), static_cast<unsigned int>(tbid)};
+    rng.seed(seq);
+}
+
 void ThreadBlock::SleepForRandomTime(double max_us) {
     if (max_us <= 0) return;
     std::uniform_real_distribution<double> dist(0.0, max_us);
@@ -200,6 +474,18 @@ std::shared_ptr<ThreadBlock> GpuRank::getThreadBlock(int tbid) const {
     return threadblocks.at(tbid);
 }
 
+size_t GpuRank::getNumThreadBlocks() const {
+    return threadblocks.size();
+}
+
+int GpuRank::getRankId() const {
+    return rank;
+}
+
+const std::vector<ChunkDataType>& GpuRank::getBuffer(BufferType buffer) const {
+    return buffers.at(buffer);
+}
+
 void GpuRank::SetThreadBlockCompleted(int tbid) {
     std::lock_guard<std::mutex> lock(tbFlagsMutex);
     if (tbid < 0 || tbid >= tb_flags.size()) {
@@ -221,6 +507,19 @@ bool GpuRank::GetThreadBlockCompleted(int tbid) const {
     return tb_flags[tbid] != 0;
 }
 
+void GpuRank::Seed(unsigned int seed) {
+    std::seed_seq seq{seed, static_cast<unsigned int>(rank)};
+    rng.seed(seq);
+    for (auto &tb : threadblocks) {
+        tb->Seed(seed);
+    }
+}
+
+void GpuRank::ResetInstructionSteps() {
+    std::lock_guard<std::mutex> lock(instructionMutex);
+    instructionSteps.clear();
+}
+
 void GpuRank::InitializeThreadBlocks(tinyxml2::XMLElement* rank_elem, std::shared_ptr<CommGroup> my_group) {
     rank = std::stoi(SafeGetAttribute(rank_elem, "id"));
     comm_group = my_group;
@@ -254,37 +553,10 @@ void GpuRank::InitializeThreadBlocks(tinyxml2::XMLElement* rank_elem, std::share
         threadblocks.push_back(std::make_shared<ThreadBlock>());
     }
 
-    ZeroThreadBlockFlags(num_tbs);
-    std::map<int, std::thread> threads;
-    for (int i = 0; i < num_tbs;++i) {
-        if (threads.size() == NUM_GPU_SMS) {
-            // Wait for an existing thread to finish
-            size_t tries = 0;
-            auto it = threads.begin();
-            while (tries < MAX_TRIES) {
-                if (it == threads.end()) {
-                    it = threads.begin();
-                }
-                if (GetThreadBlockCompleted(it->first)) {
-                    it->second.join();
-                    threads.erase(it);
-                    break;
-                }
-                ++it;
-                ++tries;
-                std::this_thread::sleep_for(SLEEP_TIME);
-            }
-            if (threads.size() == NUM_GPU_SMS) {
-                throw std::runtime_error("Timeout waiting for threadblocks to finish in rank " + std::to_string(rank) + ".");
-            }
-        }
-        threads.emplace(i, std::thread([this, i, tb_elem]() {
-            this->threadblocks[i]->Initialize(tb_elem[i], shared_from_this());
-            this->SetThreadBlockCompleted(i);
-        }));
-    }
-    for (auto& th_pair : threads) {
-        th_pair.second.join();
+    // Threadblocks only parse their attributes and steps here; channels are connected by
+    // CommGroup once every rank is loaded, so no threadblock waits for its peers
+    for (int i = 0; i < num_tbs; ++i) {
+        threadblocks[i]->Initialize(tb_elem[i], shared_from_this());
     }
     /*
     std::vector<std::thread> threads;
@@ -311,13 +583,18 @@ void GpuRank::InitializeThreadBlocks(tinyxml2::XMLElement* rank_elem, std::share
 void GpuRank::ExecuteThreadBlocks() {
     int num_tbs = threadblocks.size();
     ZeroThreadBlockFlags(num_tbs);
+    ResetInstructionSteps();
 
     std::vector<int> tb_ids;
     for (int i = 0; i < num_tbs; ++i) {
         tb_ids.push_back(i);
     }
     std::shuffle(tb_ids.begin(), tb_ids.end(), this->rng);
+    FirstError first_error;
     std::map<int, std::thread> threads;
+    // All threadblocks are launched at once, like the blocks of a kernel, and wait for free SMs
+    const bool track_wait_stats = comm_group->track_wait_stats;
+    const int64_t launch_time = track_wait_stats ? Tracer::Now() : 0;
     for (int i = 0; i < num_tbs; ++i) {
         int tbid = tb_ids[i];
         if (threads.size() == NUM_GPU_SMS) {
@@ -338,17 +615,29 @@ void GpuRank::ExecuteThreadBlocks() {
                 std::this_thread::sleep_for(SLEEP_TIME);
             }
             if (threads.size() == NUM_GPU_SMS) {
+                for (auto& th_pair : threads) {
+                    th_pair.second.join();
+                }
                 throw std::runtime_error("Timeout waiting for threadblocks to finish in rank " + std::to_string(rank) + ".");
             }
         }
-        threads.emplace(tbid, std::thread([this, tbid]() {
-            this->threadblocks[tbid]->ExecuteInstructions();
+        if (track_wait_stats && i >= NUM_GPU_SMS) {
+            // Threadblocks that found a free SM have not waited, however long their launch took
+            threadblocks[tbid]->AddSmWait(Tracer::Now() - launch_time);
+        }
+        threads.emplace(tbid, std::thread([this, tbid, &first_error]() {
+            try {
+                this->threadblocks[tbid]->ExecuteInstructions();
+            } catch (...) {
+                first_error.Capture();
+            }
             this->SetThreadBlockCompleted(tbid);
         }));
     }
     for (auto& th_pair : threads) {
         th_pair.second.join();
     }
+    first_error.RethrowIfAny();
     /*
     std::vector<std::thread> threads;
     for (int i = 0; i < num_tbs; ++i) {
@@ -369,6 +658,23 @@ void GpuRank::InitData(std::function<ChunkDataType(int, size_t)> init_func, size
     for (size_t i = 0; i < input_buff_size; ++i) {
         buffers[BufferType::input][i] = init_func(rank, i);
     }
+    // Chunks left over from a previous run must not be mistaken for results of this one
+    std::fill(buffers[BufferType::output].begin(), buffers[BufferType::output].end(), ChunkDataType());
+    std::fill(buffers[BufferType::scratch].begin(), buffers[BufferType::scratch].end(), ChunkDataType());
+
+    if (comm_group->track_provenance) {
+        for (const auto& [buffer, chunks] : buffers) {
+            auto &chunk_provenance = provenance[buffer];
+            chunk_provenance.resize(chunks.size());
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                if (buffer == BufferType::input) {
+                    chunk_provenance[i].SetOrigin(rank, i);
+                } else {
+                    chunk_provenance[i].Clear();
+                }
+            }
+        }
+    }
 }
 
 void GpuRank::CheckData(std::function<ChunkDataType(int, size_t)> check_func, size_t output_buff_size) const {
@@ -378,11 +684,27 @@ void GpuRank::CheckData(std::function<ChunkDataType(int, size_t)> check_func, si
     for (size_t i = 0; i < output_buff_size; ++i) {
         ChunkDataType expected = check_func(rank, i);
         if (buffers.at(BufferType::output)[i] != expected) {
-            throw std::runtime_error("Data mismatch in output buffer at index " + std::to_string(i) + " in rank " + std::to_string(rank) + ": Expected " + expected + ", but got " + buffers.at(BufferType::output)[i] + ".");
+            std::string path = comm_group->track_provenance ? provenance.at(BufferType::output)[i].ToString() : "";
+            throw DataMismatchError(rank, i, expected, buffers.at(BufferType::output)[i], path);
         }
     }
 }
 
+void GpuRank::RelocateBuffers() {
+    for (auto& [buffer, chunks] : buffers) {
+        std::vector<ChunkDataType> relocated(chunks.begin(), chunks.end());
+        chunks.swap(relocated);
+    }
+}
+
+NumaPageCounts GpuRank::CountBufferPages(int node) const {
+    NumaPageCounts counts;
+    for (const auto& [buffer, chunks] : buffers) {
+        counts += CountNumaPages(chunks.data(), chunks.size() * sizeof(ChunkDataType), node);
+    }
+    return counts;
+}
+
 size_t CommGroup::getNumRanks() const {
     return ranks.size();
 }
@@ -403,7 +725,162 @@ std::shared_ptr<MailboxManager> CommGroup::getMailboxManager() const {
     return mailboxManager;
 }
 
+size_t CommGroup::getNumSteps() const {
+    size_t num_steps = 0;
+    for (const auto &rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            num_steps += rank->getThreadBlock(t)->getInstructions().size();
+        }
+    }
+    return num_steps;
+}
+
+void CommGroup::Seed(unsigned int seed) {
+    for (auto &rank : ranks) {
+        rank->Seed(seed);
+    }
+}
+
+std::shared_ptr<CommGroup> CommGroup::CreateReplica() const {
+    auto replica = std::make_shared<CommGroup>();
+    replica->InitializeRanks(root_elem);
+    return replica;
+}
+
+void CommGroup::PlaceOnNumaNodes(std::shared_ptr<const NumaTopology> topology) {
+    numa = topology;
+    rank_nodes.clear();
+    for (size_t r = 0; r < ranks.size(); ++r) {
+        rank_nodes.push_back(numa->NodeOfRank(r, ranks.size()));
+    }
+    FirstError first_error;
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < ranks.size(); ++r) {
+        threads.emplace_back([this, r, &first_error]() {
+            try {
+                numa->PinThread(rank_nodes[r]);
+                ranks[r]->RelocateBuffers();
+            } catch (...) {
+                first_error.Capture();
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    first_error.RethrowIfAny();
+    unmoved_mailbox_pages = mailboxManager->PlaceMailboxes([this](int rank) { return rank_nodes[rank]; });
+}
+
+void CommGroup::PrintNumaPlacement(const NumaTopology& topology, std::ostream& os) const {
+    const int num_ranks = ranks.size();
+    std::map<int, std::pair<int, NumaPageCounts>> nodes; // Node -> ranks and buffer pages
+    NumaPageCounts buffer_pages;
+    for (int r = 0; r < num_ranks; ++r) {
+        int node = topology.NodeOfRank(r, num_ranks);
+        NumaPageCounts pages = ranks[r]->CountBufferPages(node);
+        nodes[node].first++;
+        nodes[node].second += pages;
+        buffer_pages += pages;
+    }
+    NumaPageCounts mailbox_pages = mailboxManager->CountMailboxPages([&topology, num_ranks](int rank) { return topology.NodeOfRank(rank, num_ranks); });
+    os << std::fixed << std::setprecision(1);
+    os << "NUMA placement (" << topology.ToString() << (numa ? ", pinned" : ", not pinned") << "):" << std::endl;
+    os << "  Node  Ranks  BufferPages  Remote  Remote%" << std::endl;
+    for (const auto& [node, entry] : nodes) {
+        os << std::setw(6) << node << std::setw(7) << entry.first << std::setw(13) << entry.second.local + entry.second.remote
+           << std::setw(8) << entry.second.remote << std::setw(9) << 100 * entry.second.RemoteRatio() << std::endl;
+    }
+    os << "  Remote buffer pages: " << 100 * buffer_pages.RemoteRatio() << "%, remote mailboxes: " << 100 * mailbox_pages.RemoteRatio() << "%";
+    if (buffer_pages.unplaced + mailbox_pages.unplaced > 0) {
+        os << " (" << buffer_pages.unplaced + mailbox_pages.unplaced << " pages not placed yet)";
+    }
+    if (unmoved_mailbox_pages > 0) {
+        os << " (" << unmoved_mailbox_pages << " mailbox pages could not be moved)";
+    }
+    os << std::endl << std::defaultfloat;
+}
+
+void CommGroup::EnableWaitStats(bool enable) {
+    track_wait_stats = enable;
+    UpdateTiming();
+}
+
+void CommGroup::UpdateTiming() {
+    for (auto& rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            auto tb = rank->getThreadBlock(t);
+            tb->timed = track_wait_stats || tb->trace_buffer;
+        }
+    }
+}
+
+void CommGroup::EnableProvenance(bool enable) {
+    track_provenance = enable;
+}
+
+void CommGroup::PrintWaitStats(std::ostream& os) const {
+    struct TbStats {
+        int rank;
+        int tbid;
+        WaitStats stats;
+    };
+    std::vector<TbStats> tbs;
+    WaitStats total;
+    auto ms = [](int64_t ns) { return ns / 1e6; };
+    os << std::fixed << std::setprecision(3);
+    os << "Wait time (ms)  Rank      RecvWait       DepWait        SmWait          Work" << std::endl;
+    for (const auto& rank : ranks) {
+        WaitStats rank_stats;
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            const WaitStats &stats = rank->getThreadBlock(t)->getWaitStats();
+            rank_stats += stats;
+            tbs.push_back({rank->getRankId(), static_cast<int>(t), stats});
+        }
+        total += rank_stats;
+        os << std::setw(20) << rank->getRankId() << std::setw(14) << ms(rank_stats.recv_wait_ns) << std::setw(14) << ms(rank_stats.dep_wait_ns)
+           << std::setw(14) << ms(rank_stats.sm_wait_ns) << std::setw(14) << ms(rank_stats.work_ns) << std::endl;
+    }
+    os << std::setw(20) << "all" << std::setw(14) << ms(total.recv_wait_ns) << std::setw(14) << ms(total.dep_wait_ns)
+       << std::setw(14) << ms(total.sm_wait_ns) << std::setw(14) << ms(total.work_ns) << std::endl;
+
+    const size_t num_shown = std::min<size_t>(5, tbs.size());
+    std::partial_sort(tbs.begin(), tbs.begin() + num_shown, tbs.end(), [](const TbStats& a, const TbStats& b) {
+        return a.stats.BlockedNs() > b.stats.BlockedNs();
+    });
+    os << "Most blocked threadblocks:" << std::endl;
+    for (size_t i = 0; i < num_shown; ++i) {
+        const WaitStats &stats = tbs[i].stats;
+        os << "  Rank " << tbs[i].rank << " ThreadBlock " << tbs[i].tbid << ": " << std::setw(14) << ms(stats.recv_wait_ns) << std::setw(14) << ms(stats.dep_wait_ns)
+           << std::setw(14) << ms(stats.sm_wait_ns) << std::setw(14) << ms(stats.work_ns) << std::endl;
+    }
+    os << std::defaultfloat;
+}
+
+void CommGroup::ResetWaitStats() {
+    for (auto& rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            rank->getThreadBlock(t)->ResetWaitStats();
+        }
+    }
+}
+
+void CommGroup::SetTracer(std::shared_ptr<Tracer> timeline_tracer) {
+    tracer = timeline_tracer;
+    for (auto& rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            rank->getThreadBlock(t)->trace_buffer = tracer ? tracer->getBuffer(rank->getRankId(), t) : nullptr;
+        }
+    }
+    UpdateTiming();
+}
+
+void CommGroup::SetScheduleRecorder(std::shared_ptr<ScheduleRecorder> schedule_recorder) {
+    recorder = schedule_recorder;
+}
+
 void CommGroup::InitializeRanks(tinyxml2::XMLElement* root_elem) {
+    this->root_elem = root_elem;
     int num_ranks = std::stoi(SafeGetAttribute(root_elem, "ngpus"));
     int num_chans = std::stoi(SafeGetAttribute(root_elem, "nchannels"));
     if (num_chans > 32) {
@@ -437,28 +914,72 @@ void CommGroup::InitializeRanks(tinyxml2::XMLElement* root_elem) {
         ranks.push_back(std::make_shared<GpuRank>());
     }
 
+    FirstError first_error;
     std::vector<std::thread> threads;
     for (int i = 0; i < num_ranks; ++i) {
-        threads.emplace_back([this, i, rank_elem]() {
-            this->ranks[i]->InitializeThreadBlocks(rank_elem[i], shared_from_this());
+        threads.emplace_back([this, i, rank_elem, &first_error]() {
+            try {
+                this->ranks[i]->InitializeThreadBlocks(rank_elem[i], shared_from_this());
+            } catch (...) {
+                first_error.Capture();
+            }
         });
     }
     for (auto& th : threads) {
         th.join();
     }
+    first_error.RethrowIfAny();
+
+    // Connect channels in one pass over the endpoints of all threadblocks
+    std::vector<MailboxManager::Endpoint> sends, recvs;
+    for (const auto& rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            const auto &tb = rank->getThreadBlock(t);
+            if (tb->send_peer >= 0) {
+                sends.push_back({{rank->getRankId(), tb->send_peer, tb->chan_id}, tb->tbid});
+            }
+            if (tb->recv_peer >= 0) {
+                recvs.push_back({{tb->recv_peer, rank->getRankId(), tb->chan_id}, tb->tbid});
+            }
+        }
+    }
+    mailboxManager->Connect(std::move(sends), std::move(recvs));
+    for (const auto& rank : ranks) {
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            const auto &tb = rank->getThreadBlock(t);
+            if (tb->send_peer >= 0) {
+                tb->send_mailbox = mailboxManager->getMailbox(rank->getRankId(), tb->send_peer, tb->chan_id);
+            }
+            if (tb->recv_peer >= 0) {
+                tb->recv_mailbox = mailboxManager->getMailbox(tb->recv_peer, rank->getRankId(), tb->chan_id);
+            }
+        }
+    }
 }
 
 void CommGroup::ExecuteRanks() {
-    int num_ranks = ranks.size();
+    ExecuteRanks(0, static_cast<int>(ranks.size()));
+}
+
+void CommGroup::ExecuteRanks(int first_rank, int end_rank) {
+    FirstError first_error;
     std::vector<std::thread> threads;
-    for (int i = 0; i < num_ranks; ++i) {
-        threads.emplace_back([this, i]() {
-            this->ranks[i]->ExecuteThreadBlocks();
+    for (int i = first_rank; i < end_rank; ++i) {
+        threads.emplace_back([this, i, &first_error]() {
+            try {
+                if (numa) {
+                    numa->PinThread(rank_nodes[i]);
+                }
+                this->ranks[i]->ExecuteThreadBlocks();
+            } catch (...) {
+                first_error.Capture();
+            }
         });
     }
     for (auto& th : threads) {
         th.join();
     }
+    first_error.RethrowIfAny();
 }
 
 void CommGroup::InitData(std::function<ChunkDataType(int, size_t)> init_func, size_t input_buff_size) {
@@ -471,4 +992,10 @@ void CommGroup::CheckData(std::function<ChunkDataType(int, size_t)> check_func,
     for (const auto &rank : ranks) {
         rank->CheckData(check_func, output_buff_size);
     }
+}
+
+void CommGroup::CheckData(std::function<ChunkDataType(int, size_t)> check_func, size_t output_buff_size, int first_rank, int end_rank) const {
+    for (int i = first_rank; i < end_rank; ++i) {
+        ranks.at(i)->CheckData(check_func, output_buff_size);
+    }
 }
\ No newline at end of file
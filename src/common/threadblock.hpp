@@ -1,33 +1,118 @@
 #pragma once
 #include "mailbox.hpp"
+#include "numa.hpp"
+#include "schedule_trace.hpp"
+#include "tracer.hpp"
 #include <set>
 #include <functional>
 #include <random>
 
+static const int NUM_GPU_SMS = 78; // 78 SMs on a Nvidia H20 GPU
+
 class GpuRank;
 class CommGroup;
 
+/**
+ * @brief Thrown by CheckData for the first output chunk that differs from the expected one.
+ */
+class DataMismatchError: public std::runtime_error {
+public:
+    /**
+     * @param provenance The path of the actual chunk, if provenance tracking is enabled.
+     */
+    DataMismatchError(int rank, size_t index, const ChunkDataType& expected, const ChunkDataType& actual, const std::string& provenance = "");
+
+    int rank;
+    size_t index;
+    ChunkDataType expected;
+    ChunkDataType actual;
+};
+
+/**
+ * @brief Where the wall time of threadblocks went, accumulated over runs.
+ */
+struct WaitStats {
+    int64_t recv_wait_ns = 0;  // Blocked in Mailbox::receiveMessage
+    int64_t dep_wait_ns = 0;   // Polling instructionSteps for a dependency
+    int64_t sm_wait_ns = 0;    // Waiting for a free SM before starting
+    int64_t work_ns = 0;       // Executing steps, excluding the waits above
+
+    WaitStats& operator+=(const WaitStats& other);
+    int64_t BlockedNs() const;
+};
+
 class ThreadBlock {
 public:
     void Initialize(tinyxml2::XMLElement* tb_elem, std::shared_ptr<GpuRank> my_rank);
     void LoadInstructions(tinyxml2::XMLElement* tb_elem);
     const std::vector<Instruction>& getInstructions() const;
+    int getTbId() const;
+    int getSendPeer() const;
+    int getRecvPeer() const;
+    int getChanId() const;
+    std::shared_ptr<Mailbox> getSendMailbox() const;
+    std::shared_ptr<Mailbox> getRecvMailbox() const;
+    /**
+     * @brief Checks if the step that a step depends on (if any) has been executed.
+     */
+    bool IsDependencyMet(int step) const;
+    /**
+     * @brief Checks if a step can run to completion without blocking.
+     *
+     * A step is ready if its dependency has been executed and, for receiving operations,
+     * a message is waiting in the receive mailbox.
+     */
+    bool IsStepReady(int step) const;
     void ExecuteSingleStep(int step);
+    /**
+     * @brief Completes a step as if it were a nop, only publishing it to dependent steps.
+     */
+    void SkipSingleStep(int step);
     void ExecuteInstructions();
+    /**
+     * @brief Seeds the random number generator from a run seed and the threadblock's identity.
+     */
+    void Seed(unsigned int seed);
     /**
      * @brief Sleeps for a random duration up to max_us microseconds.
      * @param max_us The maximum number of microseconds to sleep.
      * Used to stagger operations.
      */
     void SleepForRandomTime(double max_us);
+    const WaitStats& getWaitStats() const;
+    void AddSmWait(int64_t ns);
+    void ResetWaitStats();
 
 private:
+    /**
+     * @brief Executes a step, timing its waits for the wait statistics and the trace buffer if Timed.
+     */
+    template <bool Timed>
+    void ExecuteStep(int step);
+    /**
+     * @brief Receives the message of a receiving step and checks it against the instruction.
+     */
+    template <bool Timed>
+    void ReceiveMessage(const Instruction& inst, int step, Message& msg);
+    /**
+     * @brief Reduces src[i] into dst[i] for each chunk, throwing on an invalid reduction.
+     */
+    void ReduceChunks(const ChunkDataType* src, ChunkDataType* dst, size_t num_chunks, int step) const;
+    /**
+     * @brief Adds a hop to the provenance of received chunks and stores it at their destination.
+     */
+    void RecordReceivedProvenance(Message& msg, const Instruction& inst, int step);
+
     int tbid, send_peer, recv_peer, chan_id;
     std::shared_ptr<Mailbox> send_mailbox;
     std::shared_ptr<Mailbox> recv_mailbox;
     std::shared_ptr<GpuRank> gpu_rank;
     std::vector<Instruction> instructions;
     std::mt19937 rng{std::random_device{}()};
+    TraceBuffer* trace_buffer = nullptr; // Owned by the tracer of the CommGroup
+    WaitStats wait_stats; // Only written by the thread running the threadblock
+    bool timed = false; // Whether steps are timed, for the wait statistics or the tracer
+    friend class CommGroup;
 };
 
 class GpuRank: public std::enable_shared_from_this<GpuRank> {
@@ -41,14 +126,33 @@ public:
     };
 
     std::shared_ptr<ThreadBlock> getThreadBlock(int tbid) const;
+    size_t getNumThreadBlocks() const;
+    int getRankId() const;
+    const std::vector<ChunkDataType>& getBuffer(BufferType buffer) const;
     void InitializeThreadBlocks(tinyxml2::XMLElement* rank_elem, std::shared_ptr<CommGroup> my_group);
     void ExecuteThreadBlocks();
+    /**
+     * @brief Seeds the random number generators of the rank and its threadblocks.
+     */
+    void Seed(unsigned int seed);
     void InitData(std::function<ChunkDataType(int, size_t)> init_func, size_t input_buff_size);
     void CheckData(std::function<ChunkDataType(int, size_t)> check_func, size_t output_buff_size) const;
+    /**
+     * @brief Copies the buffers to memory first touched by the calling thread, e.g. one pinned to a NUMA node.
+     */
+    void RelocateBuffers();
+    /**
+     * @brief Counts the pages of the buffers on a node and elsewhere.
+     */
+    NumaPageCounts CountBufferPages(int node) const;
 
     void SetThreadBlockCompleted(int tbid);
     void ZeroThreadBlockFlags(size_t num_tbs);
     bool GetThreadBlockCompleted(int tbid) const;
+    /**
+     * @brief Forgets all executed steps, so dependencies are enforced again in the next run.
+     */
+    void ResetInstructionSteps();
 
 private:
     int rank;
@@ -68,6 +172,7 @@ private:
      * Any read-write hazard should be avoided by dependency in XML instructions
      */
     std::map<BufferType, std::vector<ChunkDataType>> buffers;
+    std::map<BufferType, std::vector<ChunkProvenance>> provenance; // Parallel to buffers; empty unless tracked
 
     friend class ThreadBlock;
 };
@@ -79,8 +184,46 @@ public:
     size_t getNumChunks() const;
     std::shared_ptr<GpuRank> getRank(int rank_id) const;
     std::shared_ptr<MailboxManager> getMailboxManager() const;
+    /**
+     * @brief Returns the number of steps of all threadblocks in all ranks.
+     */
+    size_t getNumSteps() const;
+    /**
+     * @brief Makes all random decisions of ExecuteRanks reproducible from a seed.
+     */
+    void Seed(unsigned int seed);
+    /**
+     * @brief Records the completion order of steps in every run, if the recorder is not null.
+     */
+    void SetScheduleRecorder(std::shared_ptr<ScheduleRecorder> schedule_recorder);
+    /**
+     * @brief Prints where the time of all runs so far went, per rank and for the most blocked threadblocks.
+     */
+    void PrintWaitStats(std::ostream& os) const;
+    void ResetWaitStats();
+    /**
+     * @brief Times the waits of every threadblock for PrintWaitStats. Off by default, as timing costs every step.
+     */
+    void EnableWaitStats(bool enable);
+    /**
+     * @brief Records a timeline of every threadblock in every run, if the tracer is not null.
+     */
+    void SetTracer(std::shared_ptr<Tracer> timeline_tracer);
+    /**
+     * @brief Tracks the path of every chunk from the next InitData on, and reports it on data mismatches.
+     */
+    void EnableProvenance(bool enable);
     void InitializeRanks(tinyxml2::XMLElement* root_elem);
+    /**
+     * @brief Creates an independent CommGroup with its own buffers and channels from the same XML.
+     * The XML document must outlive both groups.
+     */
+    std::shared_ptr<CommGroup> CreateReplica() const;
     void ExecuteRanks();
+    /**
+     * @brief Runs only the ranks in [first_rank, end_rank), e.g. the share of one worker process.
+     */
+    void ExecuteRanks(int first_rank, int end_rank);
     /**
      * @brief Initializes the data in the buffers of each rank.
      * @param init_func A function that takes a rank ID and an input buffer index, and returns the initial data for that chunk.
@@ -91,11 +234,35 @@ public:
      * @param check_func A function that takes a rank ID and an output buffer index, and checks the data for that chunk.
      */
     void CheckData(std::function<ChunkDataType(int, size_t)> check_func, size_t output_buff_size) const;
+    void CheckData(std::function<ChunkDataType(int, size_t)> check_func, size_t output_buff_size, int first_rank, int end_rank) const;
+    /**
+     * @brief Places every rank on a NUMA node: ExecuteRanks pins its threads there, its buffers are
+     * first-touched there, and the mailboxes it receives from are moved there.
+     */
+    void PlaceOnNumaNodes(std::shared_ptr<const NumaTopology> topology);
+    /**
+     * @brief Prints the node of the ranks and how many pages of their buffers and mailboxes are remote.
+     * Without PlaceOnNumaNodes, ranks are attributed to nodes as PlaceOnNumaNodes would place them.
+     */
+    void PrintNumaPlacement(const NumaTopology& topology, std::ostream& os) const;
 
 private:
+    /**
+     * @brief Times the steps of the threadblocks that are traced, or of all of them if wait statistics are on.
+     */
+    void UpdateTiming();
+
     size_t num_chunks;
+    tinyxml2::XMLElement* root_elem = nullptr;
     std::vector<std::shared_ptr<GpuRank>> ranks;
     std::shared_ptr<MailboxManager> mailboxManager;
+    std::shared_ptr<ScheduleRecorder> recorder;
+    std::shared_ptr<Tracer> tracer;
+    bool track_provenance = false;
+    bool track_wait_stats = false;
+    std::shared_ptr<const NumaTopology> numa; // Null unless ranks are placed on NUMA nodes
+    std::vector<int> rank_nodes; // NUMA node of every rank, if placed
+    size_t unmoved_mailbox_pages = 0; // Pages of mailboxes that PlaceOnNumaNodes failed to move
 
     friend class GpuRank;
     friend class ThreadBlock;
@@ -0,0 +1,229 @@
+#include "timing.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <queue>
+#include <sstream>
+
+TimingSimulator::TimingSimulator(const ExecGraph& graph, const CostModel& cost_model, double chunk_bytes, const Topology* topology):
+    graph(graph), cost_model(cost_model), chunk_bytes(chunk_bytes), topology(topology) {
+    if (topology && topology->getNumRanks() != graph.getNumRanks()) {
+        throw std::runtime_error("The topology has " + std::to_string(topology->getNumRanks()) + " ranks, but the XML has " + std::to_string(graph.getNumRanks()) + ".");
+    }
+}
+
+LinkClass TimingSimulator::StepLink(size_t node) const {
+    const ExecGraph::Node &n = graph.getNode(node);
+    if (IsSendOp(n.op)) {
+        return cost_model.Classify(n.rank, n.send_peer);
+    }
+    return LinkClass::local;
+}
+
+double TimingSimulator::StepDuration(size_t node) const {
+    const ExecGraph::Node &n = graph.getNode(node);
+    if (n.op == OpType::nop) {
+        return 0;
+    }
+    return cost_model.getCost(StepLink(node)).TransferTime(n.num_chunks * chunk_bytes);
+}
+
+TimingResult TimingSimulator::Run() const {
+    if (topology) {
+        return RunContended();
+    }
+    TimingResult result;
+    result.start_us.assign(graph.getNumNodes(), 0);
+    result.finish_us.assign(graph.getNumNodes(), 0);
+    for (int node : graph.TopologicalOrder()) {
+        double start = 0;
+        for (const int *p = graph.PredecessorsBegin(node); p != graph.PredecessorsEnd(node); ++p) {
+            start = std::max(start, result.finish_us[*p]);
+        }
+        result.start_us[node] = start;
+        result.finish_us[node] = start + StepDuration(node);
+        result.makespan_us = std::max(result.makespan_us, result.finish_us[node]);
+    }
+    return result;
+}
+
+TimingResult TimingSimulator::RunContended() const {
+    graph.TopologicalOrder(); // Throws if some step can never run
+    const size_t num_nodes = graph.getNumNodes();
+    const size_t num_links = topology->getNumLinks();
+    TimingResult result;
+    result.start_us.assign(num_nodes, 0);
+    result.finish_us.assign(num_nodes, 0);
+    result.link_bytes.assign(num_links, 0);
+    result.link_busy_us.assign(num_links, 0);
+    result.link_peak_flows.assign(num_links, 0);
+
+    // Events are step completions, or the end of the latency of a transfer (as ~node)
+    using Event = std::pair<double, int>;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    std::vector<Flow> flows;
+    std::vector<int> pending(num_nodes), route;
+    std::vector<int> link_flows(num_links, 0);
+    double now = 0;
+    auto start_node = [&](int node) {
+        result.start_us[node] = now;
+        const ExecGraph::Node &n = graph.getNode(node);
+        if (IsSendOp(n.op) && n.send_peer != n.rank) {
+            events.push({now + cost_model.getCost(StepLink(node)).alpha_us, ~node});
+        } else {
+            events.push({now + StepDuration(node), node});
+        }
+    };
+    for (size_t n = 0; n < num_nodes; ++n) {
+        pending[n] = static_cast<int>(graph.PredecessorsEnd(n) - graph.PredecessorsBegin(n));
+        if (pending[n] == 0) {
+            start_node(n);
+        }
+    }
+
+    std::vector<int> finished;
+    while (!events.empty() || !flows.empty()) {
+        double next = events.empty() ? std::numeric_limits<double>::infinity() : events.top().first;
+        for (const Flow &f : flows) {
+            next = std::min(next, now + f.remaining_bytes / f.rate);
+        }
+        for (Flow &f : flows) {
+            f.remaining_bytes -= f.rate * (next - now);
+        }
+        for (size_t l = 0; l < num_links; ++l) {
+            if (link_flows[l] > 0) {
+                result.link_busy_us[l] += next - now;
+            }
+        }
+        now = next;
+
+        bool flows_changed = false;
+        finished.clear();
+        for (size_t i = 0; i < flows.size();) {
+            if (flows[i].remaining_bytes <= 1e-9 * flows[i].bytes) {
+                finished.push_back(flows[i].node);
+                for (int l : flows[i].links) {
+                    --link_flows[l];
+                }
+                flows[i] = std::move(flows.back());
+                flows.pop_back();
+                flows_changed = true;
+            } else {
+                ++i;
+            }
+        }
+        while (!events.empty() && events.top().first <= now) {
+            int id = events.top().second;
+            events.pop();
+            if (id >= 0) {
+                finished.push_back(id);
+                continue;
+            }
+            int node = ~id;
+            const ExecGraph::Node &n = graph.getNode(node);
+            double bytes = n.num_chunks * chunk_bytes;
+            topology->Route(n.rank, n.send_peer, cost_model.ranks_per_node, route);
+            if (bytes <= 0 || route.empty()) {
+                finished.push_back(node);
+                continue;
+            }
+            flows.push_back({node, bytes, bytes, 0, route});
+            for (int l : route) {
+                result.link_bytes[l] += bytes;
+                result.link_peak_flows[l] = std::max(result.link_peak_flows[l], ++link_flows[l]);
+            }
+            flows_changed = true;
+        }
+        for (int node : finished) {
+            result.finish_us[node] = now;
+            result.makespan_us = std::max(result.makespan_us, now);
+            for (const int *succ = graph.SuccessorsBegin(node); succ != graph.SuccessorsEnd(node); ++succ) {
+                if (--pending[*succ] == 0) {
+                    start_node(*succ);
+                }
+            }
+        }
+        if (flows_changed) {
+            AssignFairRates(flows);
+        }
+    }
+    return result;
+}
+
+void TimingSimulator::AssignFairRates(std::vector<Flow>& flows) const {
+    std::vector<double> capacity(topology->getNumLinks(), 0);
+    std::vector<int> unfixed(topology->getNumLinks(), 0);
+    std::vector<int> active_links;
+    for (const Flow &f : flows) {
+        for (int l : f.links) {
+            if (unfixed[l]++ == 0) {
+                capacity[l] = topology->getLink(l).bandwidth_gbps * 1e3;
+                active_links.push_back(l);
+            }
+        }
+    }
+    std::vector<bool> fixed(flows.size(), false);
+    for (size_t num_fixed = 0; num_fixed < flows.size();) {
+        int bottleneck = -1;
+        double share = std::numeric_limits<double>::infinity();
+        for (int l : active_links) {
+            if (unfixed[l] > 0 && capacity[l] / unfixed[l] < share) {
+                share = capacity[l] / unfixed[l];
+                bottleneck = l;
+            }
+        }
+        for (size_t i = 0; i < flows.size(); ++i) {
+            if (fixed[i] || std::find(flows[i].links.begin(), flows[i].links.end(), bottleneck) == flows[i].links.end()) {
+                continue;
+            }
+            fixed[i] = true;
+            ++num_fixed;
+            flows[i].rate = share;
+            for (int l : flows[i].links) {
+                capacity[l] -= share;
+                --unfixed[l];
+            }
+        }
+    }
+}
+
+void TimingSimulator::PrintReport(const TimingResult& result, std::ostream& os) const {
+    const size_t num_ranks = graph.getNumRanks();
+    std::vector<double> rank_finish(num_ranks, 0);
+    std::ostringstream tbs;
+    tbs << std::fixed << std::setprecision(3);
+    for (size_t r = 0; r < num_ranks; ++r) {
+        for (size_t t = 0; t < graph.getNumThreadBlocks(r); ++t) {
+            size_t first = graph.getFirstNode(r, t), end = graph.getEndNode(r, t);
+            double busy = 0, finish = 0;
+            for (size_t n = first; n < end; ++n) {
+                busy += result.finish_us[n] - result.start_us[n];
+                finish = std::max(finish, result.finish_us[n]);
+            }
+            rank_finish[r] = std::max(rank_finish[r], finish);
+            tbs << std::setw(6) << r << std::setw(6) << t << std::setw(7) << end - first
+                << std::setw(12) << busy << std::setw(12) << finish << std::endl;
+        }
+    }
+    os << std::fixed << std::setprecision(3);
+    os << "Estimated completion time: " << result.makespan_us << " us" << std::endl;
+    os << "  Rank  Finish(us)" << std::endl;
+    for (size_t r = 0; r < num_ranks; ++r) {
+        os << std::setw(6) << r << std::setw(12) << rank_finish[r] << std::endl;
+    }
+    os << "  Rank    TB  Steps    Busy(us)  Finish(us)" << std::endl << tbs.str();
+    if (topology) {
+        os << "Link                    Bytes    Busy(us)  Util(%)  Peak flows" << std::endl;
+        for (size_t l = 0; l < topology->getNumLinks(); ++l) {
+            if (result.link_bytes[l] == 0) {
+                continue;
+            }
+            // Utilization relative to the whole run
+            double util = 100.0 * result.link_bytes[l] / (topology->getLink(l).bandwidth_gbps * 1e3 * result.makespan_us);
+            os << std::left << std::setw(16) << topology->getLink(l).name << std::right << std::setw(13) << std::setprecision(0) << result.link_bytes[l]
+               << std::setprecision(3) << std::setw(12) << result.link_busy_us[l] << std::setw(9) << std::setprecision(1) << util
+               << std::setw(12) << result.link_peak_flows[l] << std::setprecision(3) << std::endl;
+        }
+    }
+    os << std::defaultfloat;
+}
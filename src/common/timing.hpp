@@ -0,0 +1,75 @@
+#pragma once
+#include "cost_model.hpp"
+#include "exec_graph.hpp"
+#include "topology.hpp"
+
+/**
+ * @brief Modeled start and finish times of all steps.
+ */
+struct TimingResult {
+    std::vector<double> start_us;  // Per node of the ExecGraph
+    std::vector<double> finish_us; // Per node of the ExecGraph
+    double makespan_us = 0;
+    // Per link of the topology, if one is given
+    std::vector<double> link_bytes;
+    std::vector<double> link_busy_us;  // Time with at least one transfer on the link
+    std::vector<int> link_peak_flows;  // Most transfers sharing the link at once
+};
+
+/**
+ * @brief Estimates the completion time of an XML with an alpha-beta cost per step.
+ *
+ * A step starts once the previous step of its threadblock, its dependency and, for a receiving
+ * step, the step that sent its message have finished. Sending steps (s, rcs, rrs, rrcs) take
+ * the cost of the link to their peer; cpy, re, and copying a message out (r, rrc) take the
+ * local cost; nop takes no time. Threadblocks do not wait for free SMs.
+ *
+ * Without a topology, transfers do not contend for links. With one, a transfer between ranks
+ * takes the alpha of its link class and then moves its bytes over the physical links of its
+ * route, sharing each link's bandwidth with the concurrent transfers by max-min fairness: an
+ * event-driven simulation recomputes the rates whenever a transfer starts or finishes.
+ */
+class TimingSimulator {
+public:
+    /**
+     * @param chunk_bytes The size of one chunk, i.e. the buffer size over nchunksperloop.
+     */
+    TimingSimulator(const ExecGraph& graph, const CostModel& cost_model, double chunk_bytes, const Topology* topology = nullptr);
+
+    /**
+     * @brief Returns the class of the link used by a step. nop is reported as local.
+     */
+    LinkClass StepLink(size_t node) const;
+    double StepDuration(size_t node) const;
+    /**
+     * @brief Computes the times of all steps, in one pass over the topological order if there
+     * is no topology.
+     */
+    TimingResult Run() const;
+    /**
+     * @brief Prints the completion time of each rank and threadblock.
+     */
+    void PrintReport(const TimingResult& result, std::ostream& os) const;
+
+private:
+    struct Flow {
+        int node;
+        double bytes;
+        double remaining_bytes;
+        double rate; // Bytes per microsecond
+        std::vector<int> links;
+    };
+
+    TimingResult RunContended() const;
+    /**
+     * @brief Assigns max-min fair rates to flows by progressive filling: the link with the
+     * smallest fair share fixes the rate of its flows, whose bandwidth is then taken from the
+     * other links on their routes.
+     */
+    void AssignFairRates(std::vector<Flow>& flows) const;
+
+    const ExecGraph& graph;
+    CostModel cost_model;
+    double chunk_bytes;
+    const Topology* topology;
+};
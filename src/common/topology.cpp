@@ -0,0 +1,129 @@
+#include "topology.hpp"
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+Topology Topology::Load(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Cannot open topology file " + file);
+    }
+    // Read all tokens, dropping comments
+    std::vector<std::string> tokens;
+    std::string line, token;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line.substr(0, line.find('#')));
+        while (ls >> token) {
+            tokens.push_back(token);
+        }
+    }
+
+    Topology topo;
+    double nvlink_gbps = 25, pcie_gbps = 24, nic_gbps = 25;
+    std::vector<int> nvlinks, nics;
+    size_t pos = 0;
+    auto next = [&](const std::string& what) -> const std::string& {
+        if (pos >= tokens.size()) {
+            throw std::runtime_error("Missing " + what + " in topology file " + file);
+        }
+        return tokens[pos++];
+    };
+    auto next_positive = [&](const std::string& what) {
+        double value = std::stod(next(what));
+        if (value <= 0) {
+            throw std::runtime_error(what + " must be positive in topology file " + file);
+        }
+        return value;
+    };
+    while (pos < tokens.size()) {
+        const std::string keyword = tokens[pos++];
+        if (keyword == "ranks") {
+            topo.num_ranks = std::stoi(next("number of ranks"));
+            if (topo.num_ranks <= 0) {
+                throw std::runtime_error("Number of ranks must be positive in topology file " + file);
+            }
+        } else if (keyword == "nvlink_gbps") {
+            nvlink_gbps = next_positive("nvlink_gbps");
+        } else if (keyword == "pcie_gbps") {
+            pcie_gbps = next_positive("pcie_gbps");
+        } else if (keyword == "nic_gbps") {
+            nic_gbps = next_positive("nic_gbps");
+        } else if (keyword == "nvlink" || keyword == "nic") {
+            if (topo.num_ranks == 0) {
+                throw std::runtime_error("ranks must come before " + keyword + " in topology file " + file);
+            }
+            auto &values = (keyword == "nvlink") ? nvlinks : nics;
+            size_t count = (keyword == "nvlink") ? topo.num_ranks * topo.num_ranks : topo.num_ranks;
+            values.clear();
+            for (size_t i = 0; i < count; ++i) {
+                values.push_back(std::stoi(next(keyword + " entries")));
+                if (values.back() < 0) {
+                    throw std::runtime_error("Negative " + keyword + " entry in topology file " + file);
+                }
+            }
+        } else {
+            throw std::runtime_error("Unknown keyword " + keyword + " in topology file " + file);
+        }
+    }
+    if (topo.num_ranks == 0) {
+        throw std::runtime_error("Missing ranks in topology file " + file);
+    }
+
+    const int n = topo.num_ranks;
+    topo.nvlink_link.assign(n * n, -1);
+    for (int i = 0; i < n && !nvlinks.empty(); ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i != j && nvlinks[i * n + j] > 0) {
+                topo.nvlink_link[i * n + j] = topo.AddLink("nvlink " + std::to_string(i) + "->" + std::to_string(j), nvlinks[i * n + j] * nvlink_gbps);
+            }
+        }
+    }
+    for (int r = 0; r < n; ++r) {
+        topo.pcie_tx_link.push_back(topo.AddLink("pcie tx " + std::to_string(r), pcie_gbps));
+        topo.pcie_rx_link.push_back(topo.AddLink("pcie rx " + std::to_string(r), pcie_gbps));
+    }
+    std::map<int, std::pair<int, int>> nic_links; // NIC id to its tx and rx links
+    for (int r = 0; r < n; ++r) {
+        int nic = nics.empty() ? r : nics[r];
+        if (nic_links.count(nic) == 0) {
+            nic_links[nic] = {topo.AddLink("nic tx " + std::to_string(nic), nic_gbps), topo.AddLink("nic rx " + std::to_string(nic), nic_gbps)};
+        }
+        topo.nic_tx_link.push_back(nic_links[nic].first);
+        topo.nic_rx_link.push_back(nic_links[nic].second);
+    }
+    return topo;
+}
+
+int Topology::AddLink(const std::string& name, double bandwidth_gbps) {
+    links.push_back({name, bandwidth_gbps});
+    return static_cast<int>(links.size()) - 1;
+}
+
+size_t Topology::getNumRanks() const {
+    return num_ranks;
+}
+
+size_t Topology::getNumLinks() const {
+    return links.size();
+}
+
+const Topology::Link& Topology::getLink(int link) const {
+    return links.at(link);
+}
+
+void Topology::Route(int src_rank, int dst_rank, int ranks_per_node, std::vector<int>& route) const {
+    route.clear();
+    if (src_rank == dst_rank) {
+        return;
+    }
+    if (src_rank / ranks_per_node != dst_rank / ranks_per_node) {
+        route.push_back(nic_tx_link.at(src_rank));
+        route.push_back(nic_rx_link.at(dst_rank));
+    } else if (nvlink_link.at(src_rank * num_ranks + dst_rank) >= 0) {
+        route.push_back(nvlink_link[src_rank * num_ranks + dst_rank]);
+    } else {
+        route.push_back(pcie_tx_link.at(src_rank));
+        route.push_back(pcie_rx_link.at(dst_rank));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * @brief The physical links between GPUs, shared by all channels that use them.
+ *
+ * A topology file holds one keyword per line; # starts a comment.
+ *   ranks <n>              Number of ranks (must come first)
+ *   nvlink_gbps <x>        Bandwidth of one NVLink per direction (default 25)
+ *   pcie_gbps <x>          Bandwidth of the PCIe link of a GPU per direction (default 24)
+ *   nic_gbps <x>           Bandwidth of a NIC per direction (default 25)
+ *   nvlink                 Followed by n rows of n integers: the NVLinks from rank i to rank j
+ *   nic <n integers>       The NIC of each rank; NIC ids are global (default: one NIC per rank)
+ * Transfers between ranks of the same node use the NVLinks between them, or the PCIe links
+ * of both GPUs if there are none. Transfers between nodes use the NICs of both ranks.
+ */
+class Topology {
+public:
+    struct Link {
+        std::string name;
+        double bandwidth_gbps;
+    };
+
+    static Topology Load(const std::string& file);
+
+    size_t getNumRanks() const;
+    size_t getNumLinks() const;
+    const Link& getLink(int link) const;
+    /**
+     * @brief Returns the links used by a transfer from src_rank to dst_rank, none for src_rank == dst_rank.
+     */
+    void Route(int src_rank, int dst_rank, int ranks_per_node, std::vector<int>& links) const;
+
+private:
+    int AddLink(const std::string& name, double bandwidth_gbps);
+
+    int num_ranks = 0;
+    std::vector<Link> links;
+    std::vector<int> nvlink_link; // num_ranks * num_ranks; -1 if there is no NVLink
+    std::vector<int> pcie_tx_link, pcie_rx_link; // Per rank
+    std::vector<int> nic_tx_link, nic_rx_link;   // Per rank, the links of its NIC
+};
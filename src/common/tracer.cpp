@@ -0,0 +1,101 @@
+#include "tracer.hpp"
+#include "threadblock.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+void TraceBuffer::Reserve(size_t num_events) {
+    events.reserve(num_events);
+}
+
+void TraceBuffer::Clear() {
+    events.clear();
+}
+
+const std::vector<TraceEvent>& TraceBuffer::getEvents() const {
+    return events;
+}
+
+Tracer::Tracer(const CommGroup& comm_group) {
+    for (size_t r = 0; r < comm_group.getNumRanks(); ++r) {
+        auto rank = comm_group.getRank(r);
+        rank_first_track.push_back(tracks.size());
+        for (size_t t = 0; t < rank->getNumThreadBlocks(); ++t) {
+            auto tb = rank->getThreadBlock(t);
+            std::ostringstream name;
+            name << "TB " << t << " (send " << tb->getSendPeer() << ", recv " << tb->getRecvPeer() << ", chan " << tb->getChanId() << ")";
+            tracks.push_back({static_cast<int>(r), static_cast<int>(t), name.str(), TraceBuffer()});
+            // A step and at most one wait of each kind, so recording does not allocate in the first run
+            tracks.back().buffer.Reserve(3 * tb->getInstructions().size());
+        }
+    }
+    rank_first_track.push_back(tracks.size());
+}
+
+int64_t Tracer::Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceBuffer* Tracer::getBuffer(int rank_id, int tbid) {
+    return &tracks.at(rank_first_track.at(rank_id) + tbid).buffer;
+}
+
+void Tracer::Reset() {
+    for (auto& track : tracks) {
+        track.buffer.Clear();
+    }
+}
+
+static const char* EventName(TraceEvent::Kind kind) {
+    switch (kind) {
+        case TraceEvent::Kind::step: return "step";
+        case TraceEvent::Kind::recv_wait: return "recv wait";
+        case TraceEvent::Kind::dep_wait: return "dep wait";
+    }
+    return "";
+}
+
+void Tracer::Save(const std::string& file) const {
+    std::ofstream out(file);
+    if (!out) {
+        throw std::runtime_error("Cannot open trace file " + file);
+    }
+    int64_t origin = INT64_MAX;
+    for (const auto& track : tracks) {
+        for (const auto& event : track.buffer.getEvents()) {
+            origin = std::min(origin, event.begin_ns);
+        }
+    }
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&]() -> const char* {
+        const char *sep = first ? "" : ",\n";
+        first = false;
+        return sep;
+    };
+    for (size_t r = 0; r + 1 < rank_first_track.size(); ++r) {
+        out << separator() << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r << ",\"args\":{\"name\":\"Rank " << r << "\"}}";
+        out << separator() << "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":" << r << ",\"args\":{\"sort_index\":" << r << "}}";
+    }
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const auto& track : tracks) {
+        out << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << track.rank << ",\"tid\":" << track.tbid
+            << ",\"args\":{\"name\":\"" << track.name << "\"}}";
+        for (const auto& event : track.buffer.getEvents()) {
+            std::ostringstream op;
+            op << event.op;
+            out << separator() << "{\"name\":\"";
+            if (event.kind == TraceEvent::Kind::step) {
+                out << op.str() << " #" << event.step;
+            } else {
+                out << EventName(event.kind);
+            }
+            out << "\",\"cat\":\"" << EventName(event.kind) << "\",\"ph\":\"X\",\"pid\":" << track.rank << ",\"tid\":" << track.tbid
+                << ",\"ts\":" << (event.begin_ns - origin) / 1e3 << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1e3
+                << ",\"args\":{\"step\":" << event.step << ",\"op\":\"" << op.str() << "\"}}";
+        }
+    }
+    out << "\n]}\n";
+}
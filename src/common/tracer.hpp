@@ -0,0 +1,73 @@
+#pragma once
+#include "instructions.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CommGroup;
+
+struct TraceEvent {
+    enum class Kind : uint8_t {
+        step,      // A whole step, including its waits
+        recv_wait, // Waiting for the message of a receiving step
+        dep_wait   // Waiting for the step named by depid/deps
+    };
+    int64_t begin_ns;
+    int64_t end_ns;
+    int32_t step;
+    Kind kind;
+    OpType op;
+};
+
+/**
+ * @brief The events of one threadblock.
+ *
+ * Only the thread running the threadblock appends to its buffer, and the buffer is read after
+ * that thread has been joined, so recording takes no locks.
+ */
+class TraceBuffer {
+public:
+    void Record(TraceEvent::Kind kind, int step, OpType op, int64_t begin_ns, int64_t end_ns) {
+        events.push_back({begin_ns, end_ns, step, kind, op});
+    }
+    void Reserve(size_t num_events);
+    void Clear();
+    const std::vector<TraceEvent>& getEvents() const;
+
+private:
+    std::vector<TraceEvent> events;
+};
+
+/**
+ * @brief Records a timeline of every threadblock and writes it as Chrome trace JSON.
+ *
+ * The output opens in chrome://tracing or Perfetto, with one process per rank and one track
+ * per threadblock. Attach a tracer with CommGroup::SetTracer; threadblocks without a tracer
+ * pay a single branch per step.
+ */
+class Tracer {
+public:
+    explicit Tracer(const CommGroup& comm_group);
+
+    /**
+     * @brief Returns a monotonic timestamp in nanoseconds.
+     */
+    static int64_t Now();
+    TraceBuffer* getBuffer(int rank_id, int tbid);
+    /**
+     * @brief Drops all recorded events, e.g. before the next iteration.
+     */
+    void Reset();
+    void Save(const std::string& file) const;
+
+private:
+    struct Track {
+        int rank;
+        int tbid;
+        std::string name;
+        TraceBuffer buffer;
+    };
+
+    std::vector<Track> tracks;
+    std::vector<size_t> rank_first_track;
+};
@@ -0,0 +1,375 @@
+#include "traffic.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file) {
+        int fd = open(file.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::runtime_error("Cannot open traffic file " + file);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            throw std::runtime_error("Cannot map traffic file " + file);
+        }
+        if (base) {
+            madvise(base, length, MADV_SEQUENTIAL);
+        }
+    }
+    ~MappedFile() {
+        if (base) {
+            munmap(base, length);
+        }
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return static_cast<const char*>(base); }
+    const char* end() const { return begin() + length; }
+    size_t size() const { return length; }
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+};
+
+} // namespace
+
+static const char TRAFFIC_MAGIC[4] = {'T', 'M', 'A', 'T'};
+
+static std::vector<size_t> ReadBinaryTrafficMatrix(const MappedFile& mapped, int num_ranks) {
+    uint32_t file_ranks = 0;
+    memcpy(&file_ranks, mapped.begin() + sizeof(TRAFFIC_MAGIC), sizeof(file_ranks));
+    if (file_ranks != static_cast<uint32_t>(num_ranks)) {
+        throw std::runtime_error("Error reading traffic file: the matrix has " + std::to_string(file_ranks) + " ranks, expected " + std::to_string(num_ranks));
+    }
+    const size_t header = sizeof(TRAFFIC_MAGIC) + sizeof(uint32_t);
+    const size_t row_bytes = static_cast<size_t>(num_ranks) * sizeof(uint32_t);
+    size_t rows = (mapped.size() - header) / row_bytes;
+    if (rows < static_cast<size_t>(num_ranks)) {
+        throw std::runtime_error("Error reading traffic file: insufficient data for rank " + std::to_string(rows));
+    }
+    std::vector<size_t> traffic(static_cast<size_t>(num_ranks) * num_ranks);
+    const char *entries = mapped.begin() + header;
+    for (size_t i = 0; i < traffic.size(); ++i) {
+        uint32_t entry;
+        memcpy(&entry, entries + i * sizeof(uint32_t), sizeof(entry));
+        traffic[i] = entry;
+    }
+    return traffic;
+}
+
+std::vector<size_t> ReadTrafficMatrix(const std::string& file, int num_ranks) {
+    MappedFile mapped(file);
+    if (mapped.size() >= sizeof(TRAFFIC_MAGIC) + sizeof(uint32_t) && memcmp(mapped.begin(), TRAFFIC_MAGIC, sizeof(TRAFFIC_MAGIC)) == 0) {
+        return ReadBinaryTrafficMatrix(mapped, num_ranks);
+    }
+    std::vector<size_t> traffic(static_cast<size_t>(num_ranks) * num_ranks);
+    const char *p = mapped.begin(), *end = mapped.end();
+    auto is_blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+    for (int i = 0; i < num_ranks; ++i) {
+        if (p == end) {
+            throw std::runtime_error("Error reading traffic file: insufficient data for rank " + std::to_string(i));
+        }
+        const char *line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!line_end) {
+            line_end = end;
+        }
+        size_t *row = traffic.data() + static_cast<size_t>(i) * num_ranks;
+        int columns = 0;
+        while (p < line_end) {
+            while (p < line_end && is_blank(*p)) {
+                ++p;
+            }
+            size_t value = 0;
+            auto [next, ec] = std::from_chars(p, line_end, value);
+            const char *cell_end = next;
+            while (cell_end < line_end && is_blank(*cell_end)) {
+                ++cell_end;
+            }
+            if (ec != std::errc() || (cell_end < line_end && *cell_end != ',')) {
+                const char *bad_end = std::find(p, line_end, ',');
+                throw std::runtime_error("Error reading traffic file: invalid entry \"" + std::string(p, bad_end) + "\" for rank " + std::to_string(i));
+            }
+            if (columns < num_ranks) {
+                row[columns] = value;
+            }
+            ++columns;
+            p = cell_end == line_end ? line_end : cell_end + 1;
+        }
+        if (columns != num_ranks) {
+            throw std::runtime_error("Error reading traffic file: expected " + std::to_string(num_ranks) + " columns, got " + std::to_string(columns));
+        }
+        p = line_end == end ? end : line_end + 1;
+    }
+    return traffic;
+}
+
+void WriteTrafficMatrix(const std::string& file, const std::vector<size_t>& traffic_matrix, int num_ranks, bool binary) {
+    std::ofstream out(file, binary ? std::ios::binary : std::ios::out);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + file + " for writing");
+    }
+    if (binary) {
+        std::vector<uint32_t> entries(traffic_matrix.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (traffic_matrix[i] > UINT32_MAX) {
+                throw std::runtime_error("Traffic entry " + std::to_string(traffic_matrix[i]) + " does not fit the binary format");
+            }
+            entries[i] = static_cast<uint32_t>(traffic_matrix[i]);
+        }
+        uint32_t ranks = static_cast<uint32_t>(num_ranks);
+        out.write(TRAFFIC_MAGIC, sizeof(TRAFFIC_MAGIC));
+        out.write(reinterpret_cast<const char*>(&ranks), sizeof(ranks));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(uint32_t));
+    } else {
+        std::string line;
+        for (int i = 0; i < num_ranks; ++i) {
+            line.clear();
+            for (int j = 0; j < num_ranks; ++j) {
+                line += std::to_string(traffic_matrix[static_cast<size_t>(i) * num_ranks + j]);
+                line += j + 1 < num_ranks ? ',' : '\n';
+            }
+            out << line;
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("Cannot write " + file);
+    }
+}
+
+void ComputeAccumulateRowSums(const size_t *traffic_matrix, size_t *acc_row_sums, const int num_ranks) {
+    for (int i = 0; i < num_ranks * num_ranks; i += num_ranks) {
+        acc_row_sums[i] = traffic_matrix[i];
+        for (int j = 1; j < num_ranks; ++j) {
+            acc_row_sums[i + j] = acc_row_sums[i + j - 1] + traffic_matrix[i + j];
+        }
+    }
+}
+
+void ComputeAccumulateColSums(const size_t *traffic_matrix, size_t *acc_col_sums, const int num_ranks) {
+    std::copy(traffic_matrix, traffic_matrix + num_ranks, acc_col_sums);
+    for (int i = num_ranks; i < num_ranks * num_ranks; i += num_ranks) {
+        for (int j = 0; j < num_ranks; ++j) {
+            acc_col_sums[i + j] = acc_col_sums[i - num_ranks + j] + traffic_matrix[i + j];
+        }
+    }
+}
+
+void CheckTrafficSums(const std::vector<size_t>& traffic_matrix, int num_ranks, size_t chunk_factor) {
+    const size_t expected = num_ranks * chunk_factor;
+    for (int i = 0; i < num_ranks; ++i) {
+        size_t row_sum = 0;
+        for (int j = 0; j < num_ranks; ++j) {
+            row_sum += traffic_matrix[i * num_ranks + j];
+        }
+        if (row_sum != expected) {
+            throw std::runtime_error("Rank " + std::to_string(i) + " has incorrect row sum: " + std::to_string(row_sum) + ", expected " + std::to_string(expected));
+        }
+    }
+    for (int j = 0; j < num_ranks; ++j) {
+        size_t col_sum = 0;
+        for (int i = 0; i < num_ranks; ++i) {
+            col_sum += traffic_matrix[i * num_ranks + j];
+        }
+        if (col_sum != expected) {
+            throw std::runtime_error("Rank " + std::to_string(j) + " has incorrect column sum: " + std::to_string(col_sum) + ", expected " + std::to_string(expected));
+        }
+    }
+}
+
+std::vector<size_t> RandomTrafficMatrix(int num_ranks, size_t chunk_factor, std::mt19937& rng) {
+    const size_t total = num_ranks * chunk_factor;
+    // Split the total into 1 to num_ranks positive weights at random cut points
+    size_t max_parts = std::min<size_t>(total, num_ranks);
+    size_t parts = std::uniform_int_distribution<size_t>(1, max_parts)(rng);
+    std::vector<size_t> cuts;
+    while (cuts.size() + 1 < parts) {
+        size_t cut = std::uniform_int_distribution<size_t>(1, total - 1)(rng);
+        if (std::find(cuts.begin(), cuts.end(), cut) == cuts.end()) {
+            cuts.push_back(cut);
+        }
+    }
+    std::sort(cuts.begin(), cuts.end());
+    cuts.push_back(total);
+
+    std::vector<size_t> traffic(static_cast<size_t>(num_ranks) * num_ranks, 0);
+    std::vector<int> permutation(num_ranks);
+    size_t previous = 0;
+    for (size_t cut : cuts) {
+        for (int i = 0; i < num_ranks; ++i) {
+            permutation[i] = i;
+        }
+        std::shuffle(permutation.begin(), permutation.end(), rng);
+        for (int i = 0; i < num_ranks; ++i) {
+            traffic[static_cast<size_t>(i) * num_ranks + permutation[i]] += cut - previous;
+        }
+        previous = cut;
+    }
+    return traffic;
+}
+
+/**
+ * @brief Splits total into integer parts proportional to weights, by largest remainder.
+ */
+static std::vector<size_t> Apportion(const std::vector<double>& weights, size_t total) {
+    double weight_sum = 0;
+    for (double w : weights) {
+        weight_sum += w;
+    }
+    std::vector<size_t> parts(weights.size());
+    std::vector<std::pair<double, size_t>> remainders;
+    size_t assigned = 0;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        double exact = total * weights[i] / weight_sum;
+        parts[i] = static_cast<size_t>(exact);
+        assigned += parts[i];
+        remainders.push_back({exact - parts[i], i});
+    }
+    std::stable_sort(remainders.begin(), remainders.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t r = 0; assigned < total; ++r, ++assigned) {
+        parts[remainders[r % remainders.size()].second]++;
+    }
+    return parts;
+}
+
+/**
+ * @brief The matrix in which rank i sends offsets[d] chunks to rank (i + d) % num_ranks.
+ * Rows and columns all sum to the sum of the offsets.
+ */
+static std::vector<size_t> CirculantMatrix(const std::vector<size_t>& offsets, int num_ranks) {
+    std::vector<size_t> traffic(static_cast<size_t>(num_ranks) * num_ranks, 0);
+    for (int i = 0; i < num_ranks; ++i) {
+        for (int d = 0; d < num_ranks; ++d) {
+            traffic[static_cast<size_t>(i) * num_ranks + (i + d) % num_ranks] = offsets[d];
+        }
+    }
+    return traffic;
+}
+
+/**
+ * @brief Parses the whole parameter of a generator spec as a number, or throws naming the spec.
+ */
+template <typename T>
+static T ParseGeneratorParam(const std::string& spec, const std::string& param, const char* expected) {
+    T value{};
+    auto [end, ec] = std::from_chars(param.data(), param.data() + param.size(), value);
+    if (param.empty() || ec != std::errc() || end != param.data() + param.size()) {
+        throw std::runtime_error("Invalid traffic generator " + spec + ": expected " + expected);
+    }
+    return value;
+}
+
+bool IsTrafficGenerator(const std::string& spec) {
+    std::string family = spec.substr(0, spec.find(':'));
+    return family == "uniform" || family == "zipf" || family == "hot-pair" || family == "moe" || family == "random";
+}
+
+std::vector<size_t> GenerateTrafficMatrix(const std::string& spec, int num_ranks, size_t chunk_factor, std::mt19937& rng) {
+    const size_t colon = spec.find(':');
+    const std::string family = spec.substr(0, colon);
+    const bool has_param = colon != std::string::npos;
+    const std::string param = has_param ? spec.substr(colon + 1) : "";
+    const size_t total = num_ranks * chunk_factor;
+    if ((family == "uniform" || family == "random") && has_param) {
+        throw std::runtime_error("Invalid traffic generator " + spec + ": " + family + " takes no parameter");
+    }
+    if (family == "uniform") {
+        return std::vector<size_t>(static_cast<size_t>(num_ranks) * num_ranks, chunk_factor);
+    }
+    if (family == "zipf") {
+        double s = has_param ? ParseGeneratorParam<double>(spec, param, "zipf:<s> with s >= 0") : 1.0;
+        if (!std::isfinite(s) || s < 0) {
+            throw std::runtime_error("Invalid traffic generator " + spec + ": expected zipf:<s> with s >= 0");
+        }
+        std::vector<double> weights(num_ranks);
+        for (int d = 0; d < num_ranks; ++d) {
+            weights[d] = std::pow(d == 0 ? num_ranks : d, -s);
+        }
+        return CirculantMatrix(Apportion(weights, total), num_ranks);
+    }
+    if (family == "hot-pair") {
+        double fraction = has_param ? ParseGeneratorParam<double>(spec, param, "hot-pair:<fraction> with a fraction in [0, 1]") : 0.5;
+        if (!(fraction >= 0 && fraction <= 1)) {
+            throw std::runtime_error("Invalid traffic generator " + spec + ": expected hot-pair:<fraction> with a fraction in [0, 1]");
+        }
+        if (num_ranks < 2) {
+            throw std::runtime_error("Invalid traffic generator " + spec + ": hot-pair needs at least 2 ranks");
+        }
+        size_t hot = static_cast<size_t>(std::llround(fraction * total));
+        std::vector<size_t> traffic = CirculantMatrix(Apportion(std::vector<double>(num_ranks, 1.0), total - hot), num_ranks);
+        // A permutation matrix scaled by hot: 0 and 1 swap, the others map to themselves
+        traffic[1] += hot;
+        traffic[num_ranks] += hot;
+        for (int i = 2; i < num_ranks; ++i) {
+            traffic[static_cast<size_t>(i) * num_ranks + i] += hot;
+        }
+        return traffic;
+    }
+    if (family == "moe") {
+        const std::string expected = "moe:<k> with 1 <= k <= " + std::to_string(std::min<size_t>(num_ranks, total));
+        int k = has_param ? ParseGeneratorParam<int>(spec, param, expected.c_str()) : 2;
+        if (k < 1 || k > num_ranks || static_cast<size_t>(k) > total) {
+            throw std::runtime_error("Invalid traffic generator " + spec + ": expected " + expected);
+        }
+        // k distinct offsets, preferring peers over the rank itself
+        std::vector<int> candidates;
+        for (int d = 1; d < num_ranks; ++d) {
+            candidates.push_back(d);
+        }
+        std::shuffle(candidates.begin(), candidates.end(), rng);
+        candidates.push_back(0);
+        std::vector<double> shares(k);
+        for (auto& share : shares) {
+            share = std::uniform_real_distribution<double>(0.05, 1.0)(rng);
+        }
+        std::sort(shares.rbegin(), shares.rend());
+        std::vector<size_t> parts = Apportion(shares, total - k);
+        std::vector<size_t> offsets(num_ranks, 0);
+        for (int m = 0; m < k; ++m) {
+            offsets[candidates[m]] = parts[m] + 1; // Every chosen expert gets at least one chunk
+        }
+        // Relabel the ranks, so the experts of a rank are not its neighbours
+        std::vector<size_t> circulant = CirculantMatrix(offsets, num_ranks);
+        std::vector<int> label(num_ranks);
+        for (int i = 0; i < num_ranks; ++i) {
+            label[i] = i;
+        }
+        std::shuffle(label.begin(), label.end(), rng);
+        std::vector<size_t> traffic(circulant.size());
+        for (int i = 0; i < num_ranks; ++i) {
+            for (int j = 0; j < num_ranks; ++j) {
+                traffic[static_cast<size_t>(label[i]) * num_ranks + label[j]] = circulant[static_cast<size_t>(i) * num_ranks + j];
+            }
+        }
+        return traffic;
+    }
+    if (family == "random") {
+        return RandomTrafficMatrix(num_ranks, chunk_factor, rng);
+    }
+    throw std::runtime_error("Unknown traffic generator " + spec);
+}
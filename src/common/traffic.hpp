@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reads a num_ranks x num_ranks traffic matrix from a CSV file.
+ *
+ * Each entry (i,j) in the traffic matrix should be the number of chunks (rather than the amount
+ * of data) sent from rank i to rank j. The matrix is returned row by row.
+ * The file is memory-mapped and parsed in place; blanks around entries are ignored.
+ * Files in the binary format of WriteTrafficMatrix are recognized by their magic and read as is.
+ */
+std::vector<size_t> ReadTrafficMatrix(const std::string& file, int num_ranks);
+
+/**
+ * @brief Writes a traffic matrix as CSV, or in the binary format: the magic "TMAT", the number of
+ * ranks as a uint32, then the entries row by row as uint32, all in native byte order.
+ */
+void WriteTrafficMatrix(const std::string& file, const std::vector<size_t>& traffic_matrix, int num_ranks, bool binary);
+
+/**
+ * @brief Computes the accumulated row sums of the traffic matrix in the form num_ranks * num_ranks
+ * 
+ * For example,
+ * 0  1  2    0  1  3
+ * 3  4  5 => 3  7  12
+ * 6  7  8    6  13 21
+ */
+void ComputeAccumulateRowSums(const size_t *traffic_matrix, size_t *acc_row_sums, const int num_ranks);
+
+/**
+ * @brief Computes the accumulated column sums of the traffic matrix in the form num_ranks * num_ranks
+ * 
+ * For example,
+ * 0  1  2    0  1  2
+ * 3  4  5 => 3  5  7
+ * 6  7  8    9  12 15
+ */
+void ComputeAccumulateColSums(const size_t *traffic_matrix, size_t *acc_col_sums, const int num_ranks);
+
+/**
+ * @brief Checks that every rank sends and receives num_ranks * chunk_factor chunks in total.
+ * Throws naming the first rank whose row or column sum differs.
+ */
+void CheckTrafficSums(const std::vector<size_t>& traffic_matrix, int num_ranks, size_t chunk_factor);
+
+/**
+ * @brief Draws a random traffic matrix whose rows and columns all sum to num_ranks * chunk_factor.
+ *
+ * The matrix is a weighted sum of 1 to num_ranks random permutation matrices with random positive
+ * weights, so the traffic ranges from one heavy peer per rank to many light ones.
+ */
+std::vector<size_t> RandomTrafficMatrix(int num_ranks, size_t chunk_factor, std::mt19937& rng);
+
+/**
+ * @brief Returns whether spec names a matrix family of GenerateTrafficMatrix rather than a file.
+ * Only the family is checked; GenerateTrafficMatrix validates its parameter.
+ */
+bool IsTrafficGenerator(const std::string& spec);
+
+/**
+ * @brief Generates a traffic matrix whose rows and columns all sum to num_ranks * chunk_factor.
+ *
+ * The families are:
+ * - uniform: chunk_factor chunks between every pair of ranks.
+ * - zipf:<s>: rank i sends to rank i + d the share (d)^-s of its chunks (d = num_ranks for itself),
+ *   so every rank has the same hot peer.
+ * - hot-pair:<fraction>: ranks 0 and 1 exchange the given fraction of their chunks, and every other
+ *   rank keeps as much to itself; the rest is spread evenly.
+ * - moe:<k>: every rank sends to k peers with random descending shares, as tokens routed to their
+ *   top-k experts, with every expert receiving the same load.
+ * - random: a matrix of RandomTrafficMatrix.
+ * The parameter of zipf, hot-pair and moe is optional (1, 0.5 and 2 by default); uniform and random take none.
+ * Throws, naming spec, on an unknown family or a parameter that is malformed or out of range.
+ */
+std::vector<size_t> GenerateTrafficMatrix(const std::string& spec, int num_ranks, size_t chunk_factor, std::mt19937& rng);
@@ -0,0 +1,505 @@
+#include "xml_generator.hpp"
+#include "instructions.hpp"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+static const size_t MAX_MESSAGE_CHUNKS = 71; // Largest cnt accepted by Instruction
+static const int MAX_CHANNELS = 32;          // Largest nchannels accepted by CommGroup
+static const int MAX_CHANNEL_PEERS = 128;    // Most peers per rank and channel accepted by checkChannelLayout
+
+namespace {
+
+/**
+ * @brief Chunks that are contiguous in the input buffer of their origin and in the output buffer of their destination.
+ */
+struct Piece {
+    int origin;
+    size_t in_off;
+    int dest; // -1 if every rank keeps the piece, as in allgather
+    size_t out_off;
+    size_t len;
+    int chan;
+};
+
+/**
+ * @brief Where a rank holds a piece, and which step put it there (tb is -1 for the input buffer).
+ */
+struct Location {
+    BufferType buff;
+    size_t off;
+    int tb;
+    int step;
+};
+
+struct GeneratedStep {
+    const char *type;
+    BufferType src_buff;
+    size_t src_off;
+    BufferType dst_buff;
+    size_t dst_off;
+    size_t cnt;
+    int dep_tb = -1;
+    int dep_step = -1;
+    bool has_dep = false;
+};
+
+struct GeneratedTb {
+    int send;
+    int recv;
+    int chan;
+    std::vector<GeneratedStep> steps;
+};
+
+struct GeneratedRank {
+    std::vector<GeneratedTb> tbs;
+    std::map<std::tuple<int, int, int>, int> tb_ids; // (send, recv, chan) -> tbid
+    std::unordered_map<int, Location> held;
+    std::vector<int> in_transit; // Held pieces destined for another rank
+    size_t s_chunks = 0;
+};
+
+/**
+ * @brief Appends steps to the threadblocks of all ranks in one global order.
+ *
+ * Every receive is appended after the send of its message and every step after the steps it
+ * depends on, so executing the steps in the order they were appended never blocks. This makes
+ * any algorithm expressed as a sequence of copies and transfers free of deadlocks.
+ */
+class Builder {
+public:
+    explicit Builder(int num_ranks): ranks(num_ranks) {}
+
+    int AddPiece(const Piece& piece) {
+        pieces.push_back(piece);
+        int id = static_cast<int>(pieces.size()) - 1;
+        GeneratedRank &rank = ranks[piece.origin];
+        rank.held[id] = {BufferType::input, piece.in_off, -1, -1};
+        if (piece.dest >= 0 && piece.dest != piece.origin) {
+            rank.in_transit.push_back(id);
+        }
+        return id;
+    }
+
+    const Piece& getPiece(int id) const {
+        return pieces[id];
+    }
+
+    /**
+     * @brief Returns the threadblock of a rank with the given peers and channel, creating it if needed.
+     */
+    int Tb(int rank, int send, int recv, int chan) {
+        auto [it, inserted] = ranks[rank].tb_ids.insert({{send, recv, chan}, static_cast<int>(ranks[rank].tbs.size())});
+        if (inserted) {
+            ranks[rank].tbs.push_back({send, recv, chan, {}});
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Copies a piece from the input to the output buffer of its origin.
+     */
+    void Copy(int tb, int id) {
+        const Piece &piece = pieces[id];
+        AddStep(piece.origin, tb, {"cpy", BufferType::input, piece.in_off, BufferType::output, piece.out_off, piece.len});
+    }
+
+    /**
+     * @brief Sends a piece held by one rank to another, which keeps it in its output buffer if it is
+     * a destination of the piece and in its scratch buffer otherwise.
+     */
+    void Transfer(int id, int from, int from_tb, int to, int to_tb) {
+        const Piece &piece = pieces[id];
+        const Location src = ranks[from].held.at(id);
+        Location dst{BufferType::output, piece.out_off, to_tb, 0};
+        if (piece.dest >= 0 && piece.dest != to) {
+            dst.buff = BufferType::scratch;
+            dst.off = ranks[to].s_chunks;
+            ranks[to].s_chunks += piece.len;
+        }
+        GeneratedStep send{"s", src.buff, src.off, dst.buff, dst.off, piece.len};
+        if (src.tb >= 0 && src.tb != from_tb) {
+            send.dep_tb = src.tb;
+            send.dep_step = src.step;
+            ranks[from].tbs[src.tb].steps[src.step].has_dep = true;
+        }
+        AddStep(from, from_tb, send);
+        dst.step = AddStep(to, to_tb, {"r", src.buff, src.off, dst.buff, dst.off, piece.len});
+        ranks[to].held[id] = dst;
+    }
+
+    /**
+     * @brief Moves the pieces in transit round by round until all have reached their destination.
+     * @param next_hop Returns the rank a piece moves to in a round, or -1 if it stays.
+     * @param link Returns the threadblocks of the sending and the receiving rank of a transfer.
+     */
+    void RunRounds(int num_rounds, const std::function<int(int round, int rank, const Piece&)>& next_hop,
+                   const std::function<std::pair<int, int>(int from, int to, int chan)>& link) {
+        for (int round = 0; round < num_rounds; ++round) {
+            // Decide all moves first, so a piece moves at most once per round
+            std::vector<std::tuple<int, int, int>> moves; // (from, id, to)
+            for (int r = 0; r < static_cast<int>(ranks.size()); ++r) {
+                std::vector<int> staying;
+                for (int id : ranks[r].in_transit) {
+                    int to = next_hop(round, r, pieces[id]);
+                    if (to < 0) {
+                        staying.push_back(id);
+                    } else {
+                        moves.push_back({r, id, to});
+                    }
+                }
+                ranks[r].in_transit = std::move(staying);
+            }
+            for (const auto& [from, id, to] : moves) {
+                auto [from_tb, to_tb] = link(from, to, pieces[id].chan);
+                Transfer(id, from, from_tb, to, to_tb);
+                if (pieces[id].dest != to) {
+                    ranks[to].in_transit.push_back(id);
+                }
+            }
+        }
+        for (const auto& rank : ranks) {
+            if (!rank.in_transit.empty()) {
+                throw std::logic_error("Generated algorithm does not deliver all chunks");
+            }
+        }
+    }
+
+    std::string ToXml(const std::string& name, const std::string& coll, size_t num_chunks, size_t i_chunks, size_t o_chunks,
+                      GeneratedStats* stats) const {
+        int num_channels = 0;
+        GeneratedStats sizes;
+        for (const auto& rank : ranks) {
+            size_t xml_nodes = 1 + rank.tbs.size() + ranks.size();
+            for (const auto& tb : rank.tbs) {
+                num_channels = std::max(num_channels, tb.chan + 1);
+                sizes.max_steps_per_tb = std::max(sizes.max_steps_per_tb, tb.steps.size());
+                xml_nodes += tb.steps.size();
+            }
+            sizes.max_tbs_per_rank = std::max(sizes.max_tbs_per_rank, rank.tbs.size());
+            sizes.max_xml_nodes_per_rank = std::max(sizes.max_xml_nodes_per_rank, xml_nodes);
+        }
+        sizes.num_channels = num_channels;
+        if (num_channels > MAX_CHANNELS) {
+            throw std::runtime_error("Algorithm needs " + std::to_string(num_channels) + " channels, more than the limit of " + std::to_string(MAX_CHANNELS) + ".");
+        }
+        if (stats) {
+            *stats = sizes;
+        }
+
+        std::ostringstream os;
+        os << "<algo name=\"" << name << "\" proto=\"Simple\" nchannels=\"" << num_channels << "\" nchunksperloop=\"" << num_chunks
+           << "\" ngpus=\"" << ranks.size() << "\" coll=\"" << coll << "\" inplace=\"0\" outofplace=\"1\" minBytes=\"0\" maxBytes=\"0\">\n";
+        for (size_t r = 0; r < ranks.size(); ++r) {
+            os << "  <gpu id=\"" << r << "\" i_chunks=\"" << i_chunks << "\" o_chunks=\"" << o_chunks << "\" s_chunks=\"" << ranks[r].s_chunks << "\">\n";
+            for (size_t t = 0; t < ranks[r].tbs.size(); ++t) {
+                const GeneratedTb &tb = ranks[r].tbs[t];
+                os << "    <tb id=\"" << t << "\" send=\"" << tb.send << "\" recv=\"" << tb.recv << "\" chan=\"" << tb.chan << "\">\n";
+                for (size_t s = 0; s < tb.steps.size(); ++s) {
+                    const GeneratedStep &step = tb.steps[s];
+                    os << "      <step s=\"" << s << "\" type=\"" << step.type << "\" srcbuf=\"" << BufferName(step.src_buff) << "\" srcoff=\"" << step.src_off
+                       << "\" dstbuf=\"" << BufferName(step.dst_buff) << "\" dstoff=\"" << step.dst_off << "\" cnt=\"" << step.cnt
+                       << "\" depid=\"" << step.dep_tb << "\" deps=\"" << step.dep_step << "\" hasdep=\"" << (step.has_dep ? 1 : 0) << "\"/>\n";
+                }
+                os << "    </tb>\n";
+            }
+            os << "  </gpu>\n";
+        }
+        os << "</algo>\n";
+        return os.str();
+    }
+
+private:
+    int AddStep(int rank, int tb, const GeneratedStep& step) {
+        auto &steps = ranks[rank].tbs[tb].steps;
+        steps.push_back(step);
+        return static_cast<int>(steps.size()) - 1;
+    }
+
+    static const char* BufferName(BufferType buff) {
+        switch (buff) {
+            case BufferType::input: return "i";
+            case BufferType::output: return "o";
+            case BufferType::scratch: return "s";
+        }
+        return "";
+    }
+
+    std::vector<Piece> pieces;
+    std::vector<GeneratedRank> ranks;
+};
+
+} // namespace
+
+GeneratedCollective ParseGeneratedCollective(const std::string& name) {
+    if (name == "allgather") {
+        return GeneratedCollective::allgather;
+    } else if (name == "alltoall") {
+        return GeneratedCollective::alltoall;
+    } else if (name == "alltoallv") {
+        return GeneratedCollective::alltoallv;
+    }
+    throw std::runtime_error("Unknown collective " + name);
+}
+
+GeneratedAlgorithm ParseGeneratedAlgorithm(const std::string& name) {
+    if (name == "ring") {
+        return GeneratedAlgorithm::ring;
+    } else if (name == "recursive_doubling") {
+        return GeneratedAlgorithm::recursive_doubling;
+    } else if (name == "hierarchical") {
+        return GeneratedAlgorithm::hierarchical;
+    } else if (name == "direct") {
+        return GeneratedAlgorithm::direct;
+    }
+    throw std::runtime_error("Unknown algorithm " + name);
+}
+
+static const char* AlgorithmName(GeneratedAlgorithm algorithm) {
+    switch (algorithm) {
+        case GeneratedAlgorithm::ring: return "ring";
+        case GeneratedAlgorithm::recursive_doubling: return "recursive_doubling";
+        case GeneratedAlgorithm::hierarchical: return "hierarchical";
+        case GeneratedAlgorithm::direct: return "direct";
+    }
+    return "";
+}
+
+std::string GenerateXml(const GeneratorOptions& options, GeneratedStats* stats) {
+    const int W = options.num_ranks;
+    const int num_channels = options.num_channels;
+    const size_t C = options.chunk_factor;
+    const int G = options.ranks_per_node;
+    if (W < 2) {
+        throw std::runtime_error("At least 2 ranks are required.");
+    }
+    if (num_channels < 1 || C < 1) {
+        throw std::runtime_error("The number of channels and the chunk factor must be positive.");
+    }
+    if (options.collective != GeneratedCollective::alltoallv && C < static_cast<size_t>(num_channels)) {
+        throw std::runtime_error("The chunk factor (" + std::to_string(C) + ") must be at least the number of channels (" + std::to_string(num_channels) + ").");
+    }
+    if (options.algorithm == GeneratedAlgorithm::recursive_doubling && (W & (W - 1)) != 0) {
+        throw std::runtime_error("Recursive doubling requires a power-of-two number of ranks, got " + std::to_string(W) + ".");
+    }
+    if (options.algorithm == GeneratedAlgorithm::hierarchical && (G < 1 || W % G != 0)) {
+        throw std::runtime_error("The number of ranks (" + std::to_string(W) + ") must be a multiple of the ranks per node (" + std::to_string(G) + ").");
+    }
+    const int N = options.algorithm == GeneratedAlgorithm::hierarchical ? W / G : 1;
+
+    Builder builder(W);
+    auto add_pieces = [&](int origin, int dest, size_t in_off, size_t out_off, size_t len, int chan, std::vector<int>& ids) {
+        for (size_t off = 0; off < len; off += MAX_MESSAGE_CHUNKS) {
+            ids.push_back(builder.AddPiece({origin, in_off + off, dest, out_off + off, std::min(MAX_MESSAGE_CHUNKS, len - off), chan}));
+        }
+    };
+    // Channel c carries [n * c / num_channels, n * (c + 1) / num_channels) of n chunks
+    auto channel_begin = [num_channels](size_t n, int c) { return n * c / num_channels; };
+    // Links between a pair of ranks get the same channel on both sides; direct links are spread over
+    // more channels when a rank has more than 128 peers
+    const int peer_groups = (W + MAX_CHANNEL_PEERS - 1) / MAX_CHANNEL_PEERS;
+    auto pair_tb = [&](int r, int p, int c) {
+        int group = (r / MAX_CHANNEL_PEERS + p / MAX_CHANNEL_PEERS) % peer_groups;
+        return builder.Tb(r, p, p, c * peer_groups + group);
+    };
+    auto pair_link = [&](int from, int to, int c) {
+        return std::make_pair(pair_tb(from, to, c), pair_tb(to, from, c));
+    };
+    auto ring_tb = [&](int r, int c) {
+        return builder.Tb(r, (r + 1) % W, (r + W - 1) % W, c);
+    };
+    // Rank r is local rank r % G of node r / G in the hierarchical algorithm
+    auto intra_tb = [&](int r, int c) {
+        int base = r / G * G;
+        return builder.Tb(r, base + (r - base + 1) % G, base + (r - base + G - 1) % G, c);
+    };
+    auto inter_tb = [&](int r, int c) {
+        return builder.Tb(r, (r + G) % W, (r + W - G) % W, c);
+    };
+
+    if (options.collective == GeneratedCollective::allgather) {
+        // own[r][c]: the pieces of rank r on channel c
+        std::vector<std::vector<std::vector<int>>> own(W, std::vector<std::vector<int>>(num_channels));
+        for (int r = 0; r < W; ++r) {
+            for (int c = 0; c < num_channels; ++c) {
+                size_t begin = channel_begin(C, c), end = channel_begin(C, c + 1);
+                add_pieces(r, -1, begin, r * C + begin, end - begin, c, own[r][c]);
+            }
+        }
+        for (int c = 0; c < num_channels; ++c) {
+            switch (options.algorithm) {
+                case GeneratedAlgorithm::ring:
+                    for (int r = 0; r < W; ++r) {
+                        for (int id : own[r][c]) {
+                            builder.Copy(ring_tb(r, c), id);
+                        }
+                    }
+                    for (int k = 1; k < W; ++k) {
+                        for (int r = 0; r < W; ++r) {
+                            int next = (r + 1) % W;
+                            for (int id : own[(r + W - k + 1) % W][c]) {
+                                builder.Transfer(id, r, ring_tb(r, c), next, ring_tb(next, c));
+                            }
+                        }
+                    }
+                    break;
+                case GeneratedAlgorithm::recursive_doubling:
+                    for (int r = 0; r < W; ++r) {
+                        for (int id : own[r][c]) {
+                            builder.Copy(pair_tb(r, r ^ 1, c), id);
+                        }
+                    }
+                    // In round j, each rank sends the 2^j blocks it holds
+                    for (int j = 1; j < W; j <<= 1) {
+                        for (int r = 0; r < W; ++r) {
+                            int p = r ^ j;
+                            for (int o = r & ~(j - 1); o < (r & ~(j - 1)) + j; ++o) {
+                                for (int id : own[o][c]) {
+                                    builder.Transfer(id, r, pair_tb(r, p, c), p, pair_tb(p, r, c));
+                                }
+                            }
+                        }
+                    }
+                    break;
+                case GeneratedAlgorithm::hierarchical:
+                    for (int r = 0; r < W; ++r) {
+                        for (int id : own[r][c]) {
+                            builder.Copy(G > 1 ? intra_tb(r, c) : inter_tb(r, c), id);
+                        }
+                    }
+                    // A ring within each node, then a ring over the nodes forwarding whole node blocks
+                    for (int k = 1; k < G; ++k) {
+                        for (int r = 0; r < W; ++r) {
+                            int base = r / G * G;
+                            int next = base + (r - base + 1) % G;
+                            for (int id : own[base + (r - base + G - k + 1) % G][c]) {
+                                builder.Transfer(id, r, intra_tb(r, c), next, intra_tb(next, c));
+                            }
+                        }
+                    }
+                    for (int k = 1; k < N; ++k) {
+                        for (int r = 0; r < W; ++r) {
+                            int next = (r + G) % W;
+                            int node = (r / G + N - k + 1) % N;
+                            for (int l = 0; l < G; ++l) {
+                                for (int id : own[node * G + l][c]) {
+                                    builder.Transfer(id, r, inter_tb(r, c), next, inter_tb(next, c));
+                                }
+                            }
+                        }
+                    }
+                    break;
+                case GeneratedAlgorithm::direct:
+                    for (int r = 0; r < W; ++r) {
+                        for (int id : own[r][c]) {
+                            builder.Copy(pair_tb(r, (r + 1) % W, c), id);
+                        }
+                    }
+                    for (int r = 0; r < W; ++r) {
+                        for (int k = 1; k < W; ++k) {
+                            int p = (r + k) % W;
+                            for (int id : own[r][c]) {
+                                builder.Transfer(id, r, pair_tb(r, p, c), p, pair_tb(p, r, c));
+                            }
+                        }
+                    }
+                    break;
+            }
+        }
+        return builder.ToXml(AlgorithmName(options.algorithm), "allgather", W * C, C, W * C, stats);
+    }
+
+    // All-to-all: the pieces from s to d, placed by the prefix sums of the traffic matrix
+    std::vector<size_t> traffic = options.traffic_matrix;
+    if (options.collective == GeneratedCollective::alltoall) {
+        traffic.assign(static_cast<size_t>(W) * W, C);
+    } else if (traffic.size() != static_cast<size_t>(W) * W) {
+        throw std::runtime_error("The traffic matrix must have " + std::to_string(W) + " x " + std::to_string(W) + " entries.");
+    }
+    std::vector<size_t> col_offsets(W, 0);
+    std::vector<std::vector<int>> self(W);
+    for (int s = 0; s < W; ++s) {
+        size_t row_offset = 0;
+        for (int d = 0; d < W; ++d) {
+            size_t count = traffic[static_cast<size_t>(s) * W + d];
+            for (int c = 0; c < num_channels; ++c) {
+                size_t begin = channel_begin(count, c), end = channel_begin(count, c + 1);
+                std::vector<int> ids;
+                add_pieces(s, d, row_offset + begin, col_offsets[d] + begin, end - begin, c, ids);
+                if (s == d) {
+                    self[s].insert(self[s].end(), ids.begin(), ids.end());
+                }
+            }
+            row_offset += count;
+            col_offsets[d] += count;
+        }
+        if (row_offset != W * C) {
+            throw std::runtime_error("Rank " + std::to_string(s) + " sends " + std::to_string(row_offset) + " chunks, expected " + std::to_string(W * C) + ".");
+        }
+    }
+    for (int d = 0; d < W; ++d) {
+        if (col_offsets[d] != W * C) {
+            throw std::runtime_error("Rank " + std::to_string(d) + " receives " + std::to_string(col_offsets[d]) + " chunks, expected " + std::to_string(W * C) + ".");
+        }
+    }
+
+    switch (options.algorithm) {
+        case GeneratedAlgorithm::ring:
+            // With a sparse traffic matrix some links may carry nothing, but both ends must exist
+            for (int r = 0; r < W; ++r) {
+                for (int c = 0; c < num_channels; ++c) {
+                    ring_tb(r, c);
+                }
+                for (int id : self[r]) {
+                    builder.Copy(ring_tb(r, builder.getPiece(id).chan), id);
+                }
+            }
+            builder.RunRounds(W - 1, [W](int, int r, const Piece&) { return (r + 1) % W; },
+                              [&](int from, int to, int c) { return std::make_pair(ring_tb(from, c), ring_tb(to, c)); });
+            break;
+        case GeneratedAlgorithm::recursive_doubling: {
+            for (int r = 0; r < W; ++r) {
+                for (int id : self[r]) {
+                    builder.Copy(pair_link(r, r ^ 1, builder.getPiece(id).chan).first, id);
+                }
+            }
+            // In round j, pieces cross dimension j of the hypercube if their destination differs in bit j
+            int num_rounds = 0;
+            while ((1 << num_rounds) < W) {
+                ++num_rounds;
+            }
+            builder.RunRounds(num_rounds, [](int j, int r, const Piece& piece) { return ((piece.dest ^ r) >> j & 1) ? r ^ (1 << j) : -1; },
+                              pair_link);
+            break;
+        }
+        case GeneratedAlgorithm::hierarchical:
+            for (int r = 0; r < W; ++r) {
+                int first_peer = G > 1 ? r / G * G + (r % G + 1) % G : (r + G) % W;
+                for (int id : self[r]) {
+                    builder.Copy(pair_link(r, first_peer, builder.getPiece(id).chan).first, id);
+                }
+            }
+            // First to the rank of the source node with the local index of the destination, then across nodes
+            builder.RunRounds(2, [G](int round, int r, const Piece& piece) {
+                if (round == 0) {
+                    return piece.dest % G != r % G ? r / G * G + piece.dest % G : -1;
+                }
+                return piece.dest / G != r / G ? piece.dest : -1;
+            }, pair_link);
+            break;
+        case GeneratedAlgorithm::direct:
+            for (int r = 0; r < W; ++r) {
+                for (int id : self[r]) {
+                    builder.Copy(pair_link(r, (r + 1) % W, builder.getPiece(id).chan).first, id);
+                }
+            }
+            builder.RunRounds(1, [](int, int, const Piece& piece) { return piece.dest; }, pair_link);
+            break;
+    }
+    // Not a typo: the all-to-all verifiers expect the collective name used by CCF
+    return builder.ToXml(AlgorithmName(options.algorithm), "allreduce", W * C, W * C, W * C, stats);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum class GeneratedCollective {
+    allgather,
+    alltoall,
+    alltoallv
+};
+
+enum class GeneratedAlgorithm {
+    ring,               // Store and forward around a ring of all ranks
+    recursive_doubling, // Exchanges with the partner rank ^ 2^j in round j; needs a power-of-two number of ranks
+    hierarchical,       // An intra-node phase, then an inter-node phase between ranks with the same local index
+    direct              // Every pair of ranks exchanges its chunks directly
+};
+
+/**
+ * @brief Describes the algorithm to generate.
+ */
+struct GeneratorOptions {
+    GeneratedCollective collective = GeneratedCollective::allgather;
+    GeneratedAlgorithm algorithm = GeneratedAlgorithm::ring;
+    int num_ranks = 8;
+    int num_channels = 1; // Chunks are split evenly over independent channels, each with its own threadblocks
+    size_t chunk_factor = 1;
+    int ranks_per_node = 8; // Of the hierarchical algorithm
+    std::vector<size_t> traffic_matrix; // Of alltoallv: chunks from rank i to rank j at i * num_ranks + j
+};
+
+/**
+ * @brief Sizes of a generated algorithm, to compare against the limits of the verifier.
+ */
+struct GeneratedStats {
+    size_t max_tbs_per_rank = 0;
+    size_t max_steps_per_tb = 0;
+    size_t max_xml_nodes_per_rank = 0; // Counted like GpuRank::InitializeThreadBlocks
+    int num_channels = 0; // Channel IDs used, which exceeds num_channels if direct links need more than 128 peers per channel
+};
+
+GeneratedCollective ParseGeneratedCollective(const std::string& name);
+GeneratedAlgorithm ParseGeneratedAlgorithm(const std::string& name);
+
+/**
+ * @brief Generates an out-of-place algorithm in the XML schema of the verifiers.
+ *
+ * Each threadblock has one send and one receive peer per channel, so the number of threadblocks per
+ * rank follows from the algorithm and the number of channels. Chunks are moved in messages of at
+ * most 71 chunks; chunks in transit through a rank are kept in its scratch buffer. Steps that read
+ * chunks received by another threadblock depend on the receiving step. Throws on invalid options.
+ */
+std::string GenerateXml(const GeneratorOptions& options, GeneratedStats* stats = nullptr);
@@ -0,0 +1,427 @@
+#include "common/xml_generator.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Resources used by one verifier process, the median over the repetitions of a run.
+ */
+struct RunResult {
+    std::string name; // collective/algorithm/ranks:N/channels:M
+    std::string collective;
+    std::string algorithm;
+    int num_ranks;
+    int num_channels;
+    int iters;
+    int repetitions;
+    int exit_code; // Of the first failing repetition, if any
+    double wall_s;
+    double iters_per_s; // Of the iteration loop only, as printed by the verifier
+    long max_rss_kb;
+    long voluntary_ctxsw;
+    long involuntary_ctxsw;
+};
+
+struct HarnessOptions {
+    std::string verifier_dir = ".";
+    std::vector<std::string> collectives{"allgather"};
+    std::vector<std::string> algorithms{"ring"};
+    std::vector<int> ranks{8, 16, 32};
+    std::vector<int> channels{1};
+    size_t chunk_factor = 0; // 0: the number of channels
+    int iters = 10;
+    int repetitions = 5; // Runs of every verifier, compared by their median
+    std::string work_dir = "/tmp";
+    std::string output_file;
+    std::string baseline_file;
+    double max_time_regression = 0.10; // Allowed relative increase of the wall time
+    double max_rss_regression = 0.10;  // Allowed relative increase of the peak RSS
+};
+
+static bool MatchOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+static std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::istringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::vector<int> SplitIntList(const std::string& value) {
+    std::vector<int> items;
+    for (const auto& item : SplitList(value)) {
+        items.push_back(std::stoi(item));
+    }
+    return items;
+}
+
+static void PrintUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <verifier_dir> [options]" << std::endl
+              << "  --collectives=<list>         Comma-separated collectives (default allgather)" << std::endl
+              << "  --algorithms=<list>          Comma-separated algorithms of xml-generator (default ring)" << std::endl
+              << "  --ranks=<list>               Comma-separated numbers of ranks (default 8,16,32)" << std::endl
+              << "  --channels=<list>            Comma-separated numbers of channels, i.e. threadblocks per link (default 1)" << std::endl
+              << "  --chunk-factor=<n>           Chunk factor of the generated XMLs (default: the number of channels)" << std::endl
+              << "  --iters=<n>                  Iterations per verifier run (default 10)" << std::endl
+              << "  --repetitions=<n>            Runs of every verifier, reported by their median (default 5)" << std::endl
+              << "  --work-dir=<dir>             Where the generated XMLs are written (default /tmp)" << std::endl
+              << "  --output=<file>              Write the results as JSON" << std::endl
+              << "  --baseline=<file>            Compare against the results of an earlier run" << std::endl
+              << "  --max-time-regression=<f>    Allowed relative increase of the wall time (default 0.10)" << std::endl
+              << "  --max-rss-regression=<f>     Allowed relative increase of the peak RSS (default 0.10)" << std::endl;
+}
+
+static HarnessOptions ParseHarnessOptions(int argc, char* argv[]) {
+    HarnessOptions options;
+    options.verifier_dir = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string value;
+        if (MatchOption(argv[i], "--collectives", value)) {
+            options.collectives = SplitList(value);
+        } else if (MatchOption(argv[i], "--algorithms", value)) {
+            options.algorithms = SplitList(value);
+        } else if (MatchOption(argv[i], "--ranks", value)) {
+            options.ranks = SplitIntList(value);
+        } else if (MatchOption(argv[i], "--channels", value)) {
+            options.channels = SplitIntList(value);
+        } else if (MatchOption(argv[i], "--chunk-factor", value)) {
+            options.chunk_factor = std::stoul(value);
+        } else if (MatchOption(argv[i], "--iters", value)) {
+            options.iters = std::stoi(value);
+        } else if (MatchOption(argv[i], "--repetitions", value)) {
+            options.repetitions = std::stoi(value);
+        } else if (MatchOption(argv[i], "--work-dir", value)) {
+            options.work_dir = value;
+        } else if (MatchOption(argv[i], "--output", value)) {
+            options.output_file = value;
+        } else if (MatchOption(argv[i], "--baseline", value)) {
+            options.baseline_file = value;
+        } else if (MatchOption(argv[i], "--max-time-regression", value)) {
+            options.max_time_regression = std::stod(value);
+        } else if (MatchOption(argv[i], "--max-rss-regression", value)) {
+            options.max_rss_regression = std::stod(value);
+        } else {
+            throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+        }
+    }
+    for (const auto& collective : options.collectives) {
+        ParseGeneratedCollective(collective);
+    }
+    for (const auto& algorithm : options.algorithms) {
+        ParseGeneratedAlgorithm(algorithm);
+    }
+    if (options.iters < 1) {
+        throw std::runtime_error("--iters must be positive");
+    }
+    if (options.repetitions < 1) {
+        throw std::runtime_error("--repetitions must be positive");
+    }
+    return options;
+}
+
+/**
+ * @brief Runs a command with its standard output written to a file and its errors discarded, and measures it with wait4.
+ * @return The exit code, or 128 + the signal that killed the process.
+ */
+static int RunProcess(const std::vector<std::string>& args, const std::string& output_file, double& wall_s, struct rusage& usage) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto begin = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error(std::string("fork failed: ") + strerror(errno));
+    }
+    if (pid == 0) {
+        int out_fd = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (out_fd >= 0) {
+            dup2(out_fd, STDOUT_FILENO);
+            close(out_fd);
+        }
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDERR_FILENO);
+            close(null_fd);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        throw std::runtime_error(std::string("wait4 failed: ") + strerror(errno));
+    }
+    wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+/**
+ * @brief Reads the iterations per second of the iteration loop from the output of a verifier.
+ * @return The rate, or 0 if the verifier did not print it.
+ */
+static double ReadIterationRate(const std::string& output_file) {
+    std::ifstream in(output_file);
+    std::string line;
+    while (std::getline(in, line)) {
+        // "Ran <n> iterations in <s> s (<rate> iterations/s)"
+        size_t end = line.find(" iterations/s)");
+        size_t begin = line.rfind('(', end);
+        if (line.compare(0, 4, "Ran ") == 0 && end != std::string::npos && begin != std::string::npos) {
+            return std::stod(line.substr(begin + 1, end - begin - 1));
+        }
+    }
+    return 0.0;
+}
+
+/**
+ * @brief The middle value, or the mean of the two middle values of an even number of values.
+ */
+template <typename T>
+static T Median(std::vector<T> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+static RunResult RunVerifier(const HarnessOptions& options, const std::string& collective, const std::string& algorithm, int num_ranks, int num_channels) {
+    RunResult result{};
+    result.collective = collective;
+    result.algorithm = algorithm;
+    result.num_ranks = num_ranks;
+    result.num_channels = num_channels;
+    result.iters = options.iters;
+    result.repetitions = options.repetitions;
+    result.name = collective + "/" + algorithm + "/ranks:" + std::to_string(num_ranks) + "/channels:" + std::to_string(num_channels);
+
+    GeneratorOptions gen;
+    gen.collective = ParseGeneratedCollective(collective);
+    gen.algorithm = ParseGeneratedAlgorithm(algorithm);
+    gen.num_ranks = num_ranks;
+    gen.num_channels = num_channels;
+    gen.chunk_factor = options.chunk_factor > 0 ? options.chunk_factor : num_channels;
+    const std::string base = options.work_dir + "/scaling-" + collective + "-" + algorithm + "-" + std::to_string(num_ranks) + "-" + std::to_string(num_channels);
+    std::vector<std::string> args{options.verifier_dir + "/" + collective + "-verifier", base + ".xml", std::to_string(options.iters)};
+    std::vector<std::string> work_files{base + ".xml", base + ".out"};
+    if (gen.collective == GeneratedCollective::alltoallv) {
+        // A uniform matrix, so alltoallv is directly comparable with alltoall
+        gen.traffic_matrix.assign(static_cast<size_t>(num_ranks) * num_ranks, gen.chunk_factor);
+        args.push_back(base + ".csv");
+        work_files.push_back(base + ".csv");
+    }
+    // Generate before writing anything, so an unsupported combination leaves no files behind
+    std::string xml = GenerateXml(gen);
+    std::ofstream(base + ".xml") << xml;
+    if (gen.collective == GeneratedCollective::alltoallv) {
+        std::ofstream traffic(base + ".csv");
+        for (int i = 0; i < num_ranks; ++i) {
+            for (int j = 0; j < num_ranks; ++j) {
+                traffic << (j > 0 ? "," : "") << gen.chunk_factor;
+            }
+            traffic << "\n";
+        }
+    }
+
+    std::vector<double> wall_s, iters_per_s;
+    std::vector<long> max_rss_kb, voluntary_ctxsw, involuntary_ctxsw;
+    for (int rep = 0; rep < options.repetitions && result.exit_code == 0; ++rep) {
+        struct rusage usage{};
+        double wall = 0.0;
+        result.exit_code = RunProcess(args, base + ".out", wall, usage);
+        wall_s.push_back(wall);
+        iters_per_s.push_back(result.exit_code == 0 ? ReadIterationRate(base + ".out") : 0.0);
+        max_rss_kb.push_back(usage.ru_maxrss);
+        voluntary_ctxsw.push_back(usage.ru_nvcsw);
+        involuntary_ctxsw.push_back(usage.ru_nivcsw);
+    }
+    for (const auto& file : work_files) {
+        std::remove(file.c_str());
+    }
+    result.wall_s = Median(wall_s);
+    result.iters_per_s = result.exit_code == 0 ? Median(iters_per_s) : 0.0;
+    result.max_rss_kb = Median(max_rss_kb);
+    result.voluntary_ctxsw = Median(voluntary_ctxsw);
+    result.involuntary_ctxsw = Median(involuntary_ctxsw);
+    return result;
+}
+
+static void WriteResults(const std::vector<RunResult>& results, std::ostream& os) {
+    // One run per line, so results can be diffed and read back without a JSON library
+    os << "{\"runs\": [\n";
+    os << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult &r = results[i];
+        os << "  {\"name\": \"" << r.name << "\", \"collective\": \"" << r.collective << "\", \"algorithm\": \"" << r.algorithm
+           << "\", \"ranks\": " << r.num_ranks << ", \"channels\": " << r.num_channels << ", \"iters\": " << r.iters << ", \"repetitions\": " << r.repetitions
+           << ", \"exit_code\": " << r.exit_code << ", \"wall_s\": " << r.wall_s << ", \"iters_per_s\": " << r.iters_per_s
+           << ", \"max_rss_kb\": " << r.max_rss_kb << ", \"voluntary_ctxsw\": " << r.voluntary_ctxsw
+           << ", \"involuntary_ctxsw\": " << r.involuntary_ctxsw << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]}\n";
+}
+
+static bool FindField(const std::string& line, const std::string& key, std::string& value) {
+    std::string pattern = "\"" + key + "\": ";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    pos += pattern.size();
+    if (line[pos] == '"') {
+        size_t end = line.find('"', pos + 1);
+        value = line.substr(pos + 1, end - pos - 1);
+    } else {
+        size_t end = line.find_first_of(",}", pos);
+        value = line.substr(pos, end - pos);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the runs of a result file written by WriteResults, by name.
+ */
+static std::map<std::string, RunResult> ReadResults(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) {
+        throw std::runtime_error("Cannot open baseline file " + file);
+    }
+    std::map<std::string, RunResult> results;
+    std::string line;
+    while (std::getline(in, line)) {
+        RunResult r{};
+        std::string wall_s, max_rss_kb, exit_code;
+        if (!FindField(line, "name", r.name) || !FindField(line, "wall_s", wall_s) || !FindField(line, "max_rss_kb", max_rss_kb) ||
+            !FindField(line, "exit_code", exit_code)) {
+            continue;
+        }
+        r.wall_s = std::stod(wall_s);
+        r.max_rss_kb = std::stol(max_rss_kb);
+        r.exit_code = std::stoi(exit_code);
+        results[r.name] = r;
+    }
+    return results;
+}
+
+/**
+ * @brief Prints how each run compares with the baseline.
+ * @return The number of regressions, counting runs that failed but passed in the baseline.
+ */
+static int CompareWithBaseline(const std::vector<RunResult>& results, const std::map<std::string, RunResult>& baseline, const HarnessOptions& options) {
+    int regressions = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const auto& r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            std::cout << "  " << r.name << ": not in the baseline" << std::endl;
+            continue;
+        }
+        const RunResult &b = it->second;
+        if (r.exit_code != 0 && b.exit_code == 0) {
+            std::cout << "  " << r.name << ": REGRESSION, exit code " << r.exit_code << std::endl;
+            ++regressions;
+            continue;
+        }
+        double time_change = b.wall_s > 0 ? r.wall_s / b.wall_s - 1 : 0.0;
+        double rss_change = b.max_rss_kb > 0 ? static_cast<double>(r.max_rss_kb) / b.max_rss_kb - 1 : 0.0;
+        bool regressed = time_change > options.max_time_regression || rss_change > options.max_rss_regression;
+        std::cout << "  " << r.name << ": time " << std::showpos << time_change * 100 << "%, RSS " << rss_change * 100 << "%" << std::noshowpos
+                  << (regressed ? ", REGRESSION" : "") << std::endl;
+        regressions += regressed;
+    }
+    std::cout << std::defaultfloat;
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    HarnessOptions options;
+    try {
+        options = ParseHarnessOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<RunResult> results;
+    int failed_runs = 0;
+    try {
+        std::cout << std::left << std::setw(48) << "Run" << std::right << std::setw(10) << "Wall(s)" << std::setw(12) << "Iters/s"
+                  << std::setw(14) << "MaxRSS(KB)" << std::setw(10) << "CtxSw" << std::setw(6) << "Exit" << std::endl;
+        for (const auto& collective : options.collectives) {
+            for (const auto& algorithm : options.algorithms) {
+                for (int num_ranks : options.ranks) {
+                    for (int num_channels : options.channels) {
+                        RunResult r;
+                        try {
+                            r = RunVerifier(options, collective, algorithm, num_ranks, num_channels);
+                        } catch (const std::exception& e) {
+                            // E.g. recursive doubling with a number of ranks that is not a power of two
+                            std::cout << collective << "/" << algorithm << "/ranks:" << num_ranks << "/channels:" << num_channels
+                                      << ": skipped, " << e.what() << std::endl;
+                            continue;
+                        }
+                        std::cout << std::left << std::setw(48) << r.name << std::right << std::fixed << std::setprecision(3)
+                                  << std::setw(10) << r.wall_s << std::setw(12) << r.iters_per_s << std::defaultfloat << std::setw(14)
+                                  << r.max_rss_kb << std::setw(10) << r.voluntary_ctxsw + r.involuntary_ctxsw << std::setw(6) << r.exit_code << std::endl;
+                        results.push_back(r);
+                        failed_runs += r.exit_code != 0;
+                    }
+                }
+            }
+        }
+        if (!options.output_file.empty()) {
+            std::ofstream out(options.output_file);
+            if (!out) {
+                throw std::runtime_error("Cannot open output file " + options.output_file);
+            }
+            WriteResults(results, out);
+        }
+        if (!options.baseline_file.empty()) {
+            std::cout << "Comparison with " << options.baseline_file << ":" << std::endl;
+            int regressions = CompareWithBaseline(results, ReadResults(options.baseline_file), options);
+            if (regressions > 0) {
+                std::cout << regressions << " regression(s)." << std::endl;
+                return 2;
+            }
+            std::cout << "No regressions." << std::endl;
+        }
+        if (failed_runs > 0) {
+            std::cout << failed_runs << " run(s) failed." << std::endl;
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "common/traffic.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static bool MatchOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+static void PrintUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <uniform|zipf:<s>|hot-pair:<fraction>|moe:<k>|random> <ngpus> --output=<file> [options]" << std::endl
+              << "  --chunk-factor=<n>       Chunks every rank sends and receives, in units of ngpus (default 1)" << std::endl
+              << "  --seed=<n>               Seed of the random families (default 0)" << std::endl
+              << "  --format=csv|binary      Format of the output file (default: binary for a .bin file, else csv)" << std::endl
+              << "  --output=<file>          Write the matrix to a file, as read by alltoallv-verifier and xml-generator" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    std::string spec = argv[1], output_file, format;
+    int num_ranks = 0;
+    size_t chunk_factor = 1;
+    unsigned int seed = 0;
+    try {
+        num_ranks = std::stoi(argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            std::string value;
+            if (MatchOption(argv[i], "--chunk-factor", value)) {
+                chunk_factor = std::stoul(value);
+            } else if (MatchOption(argv[i], "--seed", value)) {
+                seed = std::stoul(value);
+            } else if (MatchOption(argv[i], "--format", value)) {
+                format = value;
+            } else if (MatchOption(argv[i], "--output", value)) {
+                output_file = value;
+            } else {
+                throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+            }
+        }
+        if (!IsTrafficGenerator(spec)) {
+            throw std::runtime_error("Unknown traffic generator " + spec);
+        }
+        if (num_ranks < 1 || chunk_factor < 1) {
+            throw std::runtime_error("ngpus and --chunk-factor must be positive");
+        }
+        if (output_file.empty()) {
+            throw std::runtime_error("--output is required");
+        }
+        if (!format.empty() && format != "csv" && format != "binary") {
+            throw std::runtime_error("Unknown format " + format);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    bool binary = format.empty() ? output_file.size() >= 4 && output_file.compare(output_file.size() - 4, 4, ".bin") == 0 : format == "binary";
+    try {
+        std::mt19937 rng(seed);
+        std::vector<size_t> traffic = GenerateTrafficMatrix(spec, num_ranks, chunk_factor, rng);
+        CheckTrafficSums(traffic, num_ranks, chunk_factor);
+        WriteTrafficMatrix(output_file, traffic, num_ranks, binary);
+        size_t max_entry = 0, nonzero = 0;
+        for (size_t entry : traffic) {
+            max_entry = std::max(max_entry, entry);
+            nonzero += entry > 0;
+        }
+        std::cerr << "Generated a " << num_ranks << " x " << num_ranks << " matrix with " << nonzero << " nonzero entries, the largest " << max_entry
+                  << " of " << num_ranks * chunk_factor << " chunks per rank." << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "common/threadblock.hpp"
+#include "common/traffic.hpp"
+#include "common/xml_generator.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static bool MatchOption(const char* arg, const char* name, std::string& value) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') {
+        return false;
+    }
+    value = arg + len + 1;
+    return true;
+}
+
+static void PrintUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <allgather|alltoall|alltoallv> <ring|recursive_doubling|hierarchical|direct> <ngpus> [options]" << std::endl
+              << "  --nchannels=<n>          Split the chunks over n channels (default 1)" << std::endl
+              << "  --chunk-factor=<n>       Chunks per rank, or per pair of ranks for all-to-all (default 1)" << std::endl
+              << "  --ranks-per-node=<n>     Ranks per node of the hierarchical algorithm (default 8)" << std::endl
+              << "  --traffic=<file>         Traffic matrix of alltoallv (CSV or binary), as given to alltoallv-verifier" << std::endl
+              << "  --output=<file>          Write the XML to a file instead of stdout" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    GeneratorOptions options;
+    std::string traffic_file, output_file;
+    try {
+        options.collective = ParseGeneratedCollective(argv[1]);
+        options.algorithm = ParseGeneratedAlgorithm(argv[2]);
+        options.num_ranks = std::stoi(argv[3]);
+        for (int i = 4; i < argc; ++i) {
+            std::string value;
+            if (MatchOption(argv[i], "--nchannels", value)) {
+                options.num_channels = std::stoi(value);
+            } else if (MatchOption(argv[i], "--chunk-factor", value)) {
+                options.chunk_factor = std::stoul(value);
+            } else if (MatchOption(argv[i], "--ranks-per-node", value)) {
+                options.ranks_per_node = std::stoi(value);
+            } else if (MatchOption(argv[i], "--traffic", value)) {
+                traffic_file = value;
+            } else if (MatchOption(argv[i], "--output", value)) {
+                output_file = value;
+            } else {
+                throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+            }
+        }
+        if ((options.collective == GeneratedCollective::alltoallv) != !traffic_file.empty()) {
+            throw std::runtime_error("--traffic is required for alltoallv and only allowed for it");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    GeneratedStats stats;
+    std::string xml;
+    try {
+        if (!traffic_file.empty()) {
+            options.traffic_matrix = ReadTrafficMatrix(traffic_file, options.num_ranks);
+            // The verifier counts chunks per rank in units of the chunk factor
+            size_t row_sum = 0;
+            for (int j = 0; j < options.num_ranks; ++j) {
+                row_sum += options.traffic_matrix[j];
+            }
+            options.chunk_factor = row_sum / options.num_ranks;
+        }
+        xml = GenerateXml(options, &stats);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (output_file.empty()) {
+        std::cout << xml;
+    } else {
+        std::ofstream out(output_file);
+        if (!(out << xml)) {
+            std::cerr << "Error: Cannot write " << output_file << std::endl;
+            return 1;
+        }
+    }
+    std::cerr << "Generated " << options.num_ranks << " ranks, " << stats.num_channels << " channels, up to " << stats.max_tbs_per_rank
+              << " threadblocks per rank, " << stats.max_steps_per_tb << " steps per threadblock and " << stats.max_xml_nodes_per_rank
+              << " XML nodes per rank." << std::endl;
+    if (stats.max_steps_per_tb > 256 || stats.max_xml_nodes_per_rank > 4096) {
+        std::cerr << "Warning: The verifiers accept at most 256 steps per threadblock and 4096 XML nodes per rank." << std::endl;
+    }
+    if (stats.max_tbs_per_rank > static_cast<size_t>(NUM_GPU_SMS)) {
+        std::cerr << "Warning: More than " << NUM_GPU_SMS << " threadblocks per rank run in waves, which can time out." << std::endl;
+    }
+    return 0;
+}